@@ -0,0 +1,185 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#include "HostModule.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Input stream, chances are per sample
+constexpr const int kStreamMinPeriod = 8;
+constexpr const int kStreamMaxPeriod = 2400;
+constexpr const double kStreamTempoChance = 0.1;
+constexpr const double kStreamResetChance = 1.0 / 20000;
+constexpr const double kStreamEdgeResetChance = 1.0 / 200;
+constexpr const double kStreamRunChance = 1.0 / 60000;
+constexpr const double kStreamPosChance = 1.0 / 30000;
+constexpr const double kStreamFillChance = 1.0 / 50000;
+constexpr const int kStreamPulseLen = 4;
+
+// Step fields randomEdit() changes, as PARAM_STEP_* ids
+static const int kEditFields[] = {
+    HardSeqs::PARAM_STEP_ENABLED, HardSeqs::PARAM_STEP_EACH1, HardSeqs::PARAM_STEP_EACH2, HardSeqs::PARAM_STEP_EACH3,
+    HardSeqs::PARAM_STEP_EACH4, HardSeqs::PARAM_STEP_EACH5, HardSeqs::PARAM_STEP_PROB, HardSeqs::PARAM_STEP_MOD1,
+    HardSeqs::PARAM_STEP_MOD2, HardSeqs::PARAM_STEP_MOD3, HardSeqs::PARAM_STEP_ELEN, HardSeqs::PARAM_STEP_GLIDE,
+    HardSeqs::PARAM_STEP_DURATION, HardSeqs::PARAM_STEP_ACCENT, HardSeqs::PARAM_STEP_LANE5, HardSeqs::PARAM_STEP_COND,
+    HardSeqs::PARAM_STEP_CYCLE_A, HardSeqs::PARAM_STEP_CYCLE_B,
+};
+constexpr const int kEditFieldCount = sizeof(kEditFields) / sizeof(kEditFields[0]);
+
+int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::unique_ptr<HardSeqs> createModule(uint32_t seed)
+{
+    std::unique_ptr<HardSeqs> module(new HardSeqs);
+    module->model = modelHardSeqs;
+
+    for (const int input_id : {HardSeqs::INP_RUN, HardSeqs::INP_POS, HardSeqs::INP_CLOCK, HardSeqs::INP_RST, HardSeqs::INP_FILL})
+        module->inputs[input_id].channels = 1;
+    for (auto &output : module->outputs)
+        output.channels = 1;
+
+    randomizeSteps(*module, seed);
+    return module;
+}
+
+void randomizeSteps(HardSeqs &module, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> chance(0.0, 1.0);
+    std::uniform_real_distribution<float> lane_value(-100.0, 100.0);
+
+    auto pick = [&rng] (int min_value, int max_value) {
+        return std::uniform_int_distribution<int>(min_value, max_value)(rng);
+    };
+
+    for (auto &step : module.m_steps) {
+        step.is_enabled = chance(rng) < 0.5;
+        for (auto &each : step.each_n)
+            each = chance(rng) < 0.85;
+
+        step.len_each_n = chance(rng) < 0.7 ? kLenEach : pick(1, kLenEach);
+        step.prob = chance(rng) < 0.7 ? 100 : pick(10, 95);
+
+        for (auto &value : step.values)
+            value = lane_value(rng);
+        step.values[kAccentLane] = std::abs(step.values[kAccentLane]);
+
+        step.is_glide = chance(rng) < 0.2;
+        step.duration = chance(rng) < 0.85 ? 1 : pick(2, 4);
+        step.condition = chance(rng) < 0.8 ? HardSeqs::TRIG_ALWAYS : pick(HardSeqs::TRIG_FILL, HardSeqs::TRIG_COUNT - 1);
+        step.cycle_b = pick(1, 4);
+        step.cycle_a = pick(1, step.cycle_b);
+    }
+
+    // CV address mode needs a cable on INP_ADDR, leave it out
+    module.getParam(HardSeqs::PARAM_LEN).setValue(chance(rng) < 0.6 ? kLenSteps : pick(1, kLenSteps));
+    module.getParam(HardSeqs::PARAM_DIRECTION).setValue(chance(rng) < 0.7 ? HardSeqs::DIR_FORWARD : pick(HardSeqs::DIR_REVERSE, HardSeqs::DIR_RANDOM_WALK));
+    module.getParam(HardSeqs::PARAM_CLOCK_RATE).setValue(chance(rng) < 0.8 ? kClockDefaultRate : pick(0, kClockRates.size() - 1));
+
+    // what the constructor drew from the unseeded generator, drawn again from the seed
+    module.rand_gen_.seed(seed);
+    module.shuffleMorphThresholds();
+    module.rollProbabilityMask();
+    module.beginLoop(module.sequenceLength(false));
+    module.setSelectedStep(0);
+}
+
+InputStream::InputStream(uint32_t seed)
+    : m_rng(seed)
+{
+}
+
+InputFrame InputStream::next()
+{
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    InputFrame frame;
+
+    if (m_clock_phase <= 0) {
+        if (m_clock_period == 0 || chance(m_rng) < kStreamTempoChance)
+            m_clock_period = std::uniform_int_distribution<int>(kStreamMinPeriod, kStreamMaxPeriod)(m_rng);
+
+        m_clock_phase = m_clock_period;
+    }
+
+    const bool is_clock_edge = m_clock_phase == m_clock_period;
+    const bool is_clock_high = m_clock_phase > m_clock_period / 2;
+    m_clock_phase--;
+
+    // some resets follow a clock edge by a few samples, across the whole reset window
+    if (is_clock_edge && chance(m_rng) < kStreamEdgeResetChance)
+        m_reset_delay = std::uniform_int_distribution<int>(0, kResetWindows.back() + 1)(m_rng);
+
+    if (chance(m_rng) < kStreamResetChance || m_reset_delay == 0)
+        m_reset_hold = kStreamPulseLen;
+    if (m_reset_delay >= 0)
+        m_reset_delay--;
+    if (chance(m_rng) < kStreamRunChance)
+        m_run_hold = kStreamPulseLen;
+    if (chance(m_rng) < kStreamPosChance)
+        m_pos = chance(m_rng) < 0.5 ? 0.0 : static_cast<float>(chance(m_rng) * 5.0);
+    if (chance(m_rng) < kStreamFillChance)
+        m_is_fill = !m_is_fill;
+
+    frame.clock = is_clock_high ? kMaximumVoltage : 0.0;
+    frame.reset = m_reset_hold > 0 ? kMaximumVoltage : 0.0;
+    frame.run = m_run_hold > 0 ? kMaximumVoltage : 0.0;
+    frame.pos = m_pos;
+    frame.fill = m_is_fill ? kMaximumVoltage : 0.0;
+
+    m_reset_hold = std::max(0, m_reset_hold - 1);
+    m_run_hold = std::max(0, m_run_hold - 1);
+
+    return frame;
+}
+
+void writeInputs(HardSeqs &module, const InputFrame &frame)
+{
+    module.inputs[HardSeqs::INP_RUN].setVoltage(frame.run);
+    module.inputs[HardSeqs::INP_POS].setVoltage(frame.pos);
+    module.inputs[HardSeqs::INP_CLOCK].setVoltage(frame.clock);
+    module.inputs[HardSeqs::INP_RST].setVoltage(frame.reset);
+    module.inputs[HardSeqs::INP_FILL].setVoltage(frame.fill);
+}
+
+void randomEdit(HardSeqs &module, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> chance(0.0, 1.0);
+    const int what = std::uniform_int_distribution<int>(0, 9)(rng);
+
+    if (what == 0) {
+        module.getParam(HardSeqs::PARAM_LEN).setValue(std::uniform_int_distribution<int>(1, kLenSteps)(rng));
+    } else if (what == 1) {
+        module.getParam(HardSeqs::PARAM_REPEAT_N).setValue(std::uniform_int_distribution<int>(0, 4)(rng));
+    } else {
+        const int step = std::uniform_int_distribution<int>(0, kLenSteps - 1)(rng);
+        const int param_id = kEditFields[std::uniform_int_distribution<int>(0, kEditFieldCount - 1)(rng)];
+        const auto quantity = module.getParamQuantity(param_id);
+
+        float value = quantity->minValue + chance(rng) * (quantity->maxValue - quantity->minValue);
+        if (HardSeqs::valueLane(param_id) < 0)
+            value = std::round(value);
+
+        module.m_steps[step].setField(param_id, value);
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <random>
+
+#include "HardSeqs.hpp"
+
+// Monotonic clock for the host tools
+int64_t nowNs();
+
+// A HardSeqs as the engine adds it, with cables on the run, pos, clock, reset and fill inputs and
+// on every output. The step table, LEN, direction and clock rate are drawn from seed and the module's
+// random generator is seeded with it, so two modules built from one seed play the same.
+std::unique_ptr<HardSeqs> createModule(uint32_t seed);
+
+// Fills the step table with a plausible pattern: about half the gates on, mostly full ELEN and
+// probability, values on every lane, some glides, longer steps and trig conditions
+void randomizeSteps(HardSeqs &module, uint32_t seed);
+
+// Voltages of the cabled inputs for one sample
+struct InputFrame
+{
+    float run = 0.0;
+    float pos = 0.0;
+    float clock = 0.0;
+    float reset = 0.0;
+    float fill = 0.0;
+};
+
+// Seeded cables for the cabled inputs: a clock whose tempo jumps every few edges, resets at
+// random and shortly after clock edges, run toggles, start position jumps and held fill gates
+class InputStream
+{
+public:
+    explicit InputStream(uint32_t seed);
+
+    InputFrame next();
+
+private:
+    std::mt19937 m_rng;
+    int m_clock_period = 0;
+    int m_clock_phase = 0;
+    int m_reset_hold = 0;
+    int m_reset_delay = -1;
+    int m_run_hold = 0;
+    float m_pos = 0.0;
+    bool m_is_fill = false;
+};
+
+void writeInputs(HardSeqs &module, const InputFrame &frame);
+
+// One random edit between two samples, as the UI makes them: a step field, LEN or REPEAT.
+// Step fields are written to m_steps, so call it from the thread that runs process().
+void randomEdit(HardSeqs &module, std::mt19937 &rng);
@@ -0,0 +1,37 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#include "Plugin.hpp"
+
+// The host loads no plugin, HardSeqs only compares expander neighbours against modelHardSeqs
+static Model hardSeqsModel;
+
+Plugin* pluginInstance = nullptr;
+Model* modelHardSeqs = &hardSeqsModel;
+
+namespace rack {
+namespace asset {
+
+std::string user(std::string filename)
+{
+    return filename;
+}
+
+} // namespace asset
+} // namespace rack
@@ -0,0 +1,203 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+// hs_bench: the costs of one HardSeqs that the running engine hides or spreads out.
+//
+//   hs_bench [--patch module.json] [--seed 1] [--seconds 10] [--runs 100]
+//
+// Construction and the dataToJson/dataFromJson round trip are averaged over runs. process() is
+// timed over the given seconds at 48 kHz, with the cabled inputs played back from buffers
+// recorded from an InputStream beforehand, so the time covers process() with its port and light
+// writes and the cable copies Rack makes, nothing else:
+//
+//   hs_bench: ctor 14.2us, dataToJson 38.5us, dataFromJson 52.1us, process 71 ns/sample over
+//             480000 samples, block p50 17us p99 25us max 60us
+//
+// --patch takes a module object copied from a .vcv patch ({"params": [...], "data": {...}}) or
+// its "data" object alone. Without it the module comes from createModule(seed). Link group,
+// remote control and library path are removed from the data, the benchmark stays off shared state.
+
+#include "HostModule.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+constexpr const float kBenchSampleRate = 48000.0;
+constexpr const int kBenchBlockLen = 256;
+
+struct BenchOptions
+{
+    const char *patch_path = nullptr;
+    uint32_t seed = 1;
+    double seconds = 10.0;
+    int runs = 100;
+};
+
+// Module data from a patch file with the keys that reach outside the module removed, params of
+// a module object are applied to module
+static json_t* loadPatch(const char *path, HardSeqs &module)
+{
+    json_error_t error;
+    json_t *root = json_load_file(path, 0, &error);
+    if (!root) {
+        std::fprintf(stderr, "hs_bench: %s:%d: %s\n", path, error.line, error.text);
+        return nullptr;
+    }
+
+    json_t *data = json_object_get(root, "data");
+    json_t *params = json_object_get(root, "params");
+
+    if (params) {
+        size_t i;
+        json_t *param;
+        json_array_foreach(params, i, param) {
+            const int param_id = static_cast<int>(json_integer_value(json_object_get(param, "id")));
+            json_t *value = json_object_get(param, "value");
+
+            if (param_id >= 0 && param_id < HardSeqs::PARAM_COUNT && value)
+                module.getParam(param_id).setValue(static_cast<float>(json_number_value(value)));
+        }
+    }
+
+    data = json_incref(data ? data : root);
+    json_decref(root);
+
+    for (const char *key : {"link_group", "remote", "library_path"})
+        json_object_del(data, key);
+
+    return data;
+}
+
+static int64_t percentile(std::vector<int64_t> &values, double fraction)
+{
+    const size_t index = std::min(values.size() - 1, static_cast<size_t>(values.size() * fraction));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static void printUsage()
+{
+    std::fprintf(stderr, "usage: hs_bench [--patch module.json] [--seed 1] [--seconds 10] [--runs 100]\n");
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+
+    for (int i = 1; i < argc; i += 2) {
+        const char *value = i + 1 < argc ? argv[i + 1] : "";
+        bool is_valid = true;
+
+        if (std::strcmp(argv[i], "--patch") == 0) {
+            options.patch_path = value;
+            is_valid = *value != '\0';
+        } else if (std::strcmp(argv[i], "--seed") == 0) {
+            options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (std::strcmp(argv[i], "--seconds") == 0) {
+            options.seconds = std::atof(value);
+            is_valid = options.seconds > 0.0;
+        } else if (std::strcmp(argv[i], "--runs") == 0) {
+            options.runs = std::atoi(value);
+            is_valid = options.runs > 0;
+        } else {
+            is_valid = false;
+        }
+
+        if (!is_valid) {
+            printUsage();
+            return 1;
+        }
+    }
+
+    std::vector<std::unique_ptr<HardSeqs>> probes;
+
+    const int64_t ctor_start = nowNs();
+    for (int i = 0; i < options.runs; ++i)
+        probes.emplace_back(new HardSeqs);
+    const int64_t ctor_ns = nowNs() - ctor_start;
+
+    probes.clear();
+
+    auto module = createModule(options.seed);
+    module->m_is_running = true;
+
+    json_t *patch = options.patch_path ? loadPatch(options.patch_path, *module) : module->dataToJson();
+    if (!patch)
+        return 1;
+
+    int64_t to_json_ns = 0;
+    int64_t from_json_ns = 0;
+
+    for (int i = 0; i < options.runs; ++i) {
+        const int64_t from_start = nowNs();
+        module->dataFromJson(patch);
+        const int64_t to_start = nowNs();
+        json_t *copy = module->dataToJson();
+        to_json_ns += nowNs() - to_start;
+        from_json_ns += to_start - from_start;
+
+        json_decref(copy);
+    }
+
+    json_decref(patch);
+    module->m_is_running = true;
+
+    // recorded before timing, so the loop below only copies voltages like Rack's cables
+    const int samples = std::max(kBenchBlockLen, static_cast<int>(options.seconds * kBenchSampleRate) / kBenchBlockLen * kBenchBlockLen);
+    std::vector<InputFrame> frames(samples);
+    InputStream inputs(options.seed);
+    for (auto &frame : frames)
+        frame = inputs.next();
+
+    Module::ProcessArgs args;
+    args.sampleRate = kBenchSampleRate;
+    args.sampleTime = 1.0f / kBenchSampleRate;
+
+    std::vector<int64_t> block_ns;
+    int64_t process_ns = 0;
+
+    for (int block = 0; block < samples; block += kBenchBlockLen) {
+        const int64_t block_start = nowNs();
+
+        for (int i = block; i < block + kBenchBlockLen; ++i) {
+            writeInputs(*module, frames[i]);
+            args.frame = i;
+            module->process(args);
+        }
+
+        block_ns.push_back(nowNs() - block_start);
+        process_ns += block_ns.back();
+    }
+
+    const int64_t max_block_ns = *std::max_element(block_ns.begin(), block_ns.end());
+
+    std::printf("hs_bench: ctor %.1fus, dataToJson %.1fus, dataFromJson %.1fus, process %.0f ns/sample over %d samples, "
+        "block p50 %lldus p99 %lldus max %lldus\n",
+        ctor_ns * 1e-3 / options.runs, to_json_ns * 1e-3 / options.runs, from_json_ns * 1e-3 / options.runs,
+        static_cast<double>(process_ns) / samples, samples,
+        static_cast<long long>(percentile(block_ns, 0.5) / 1000),
+        static_cast<long long>(percentile(block_ns, 0.99) / 1000),
+        static_cast<long long>(max_block_ns / 1000));
+
+    return 0;
+}
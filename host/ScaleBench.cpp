@@ -0,0 +1,378 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+// hs_scale: how process() cost scales with the number of HardSeqs instances and engine threads.
+// Every configuration builds its instances from seeded random step tables, drives them with one
+// shared clock or one clock per instance and steps them the way Rack's engine does: per frame
+// the main thread copies the clock cables, then all threads take modules from a shared index
+// until none are left and meet at a barrier. One line per configuration:
+//
+//   hs_scale: 256 instances, 4 threads, shared clock: 9.8M samples/s, 102 ns/sample, 0.8x realtime,
+//             block p50 1310us p99 2210us max 3050us, 3 of 187 blocks over 5333us, 0.81 cache misses/sample
+//
+// Blocks are one audio block of all instances, the time Rack has before the audio device needs
+// it. Cache misses are read once per block on every thread, Linux perf only.
+
+#include "HostModule.hpp"
+#include "PerfCounter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr const float kScaleSampleRate = 48000.0;
+constexpr const int kScaleWarmupBlocks = 8;
+// 16ths at 120 BPM, independent clocks run from 200 to 30 BPM
+constexpr const int kScaleSharedClockSamples = 6000;
+constexpr const int kScaleMinClockSamples = 3600;
+constexpr const int kScaleMaxClockSamples = 24000;
+
+struct ScaleOptions
+{
+    std::vector<int> instances = {1, 4, 16, 64, 256, 1024};
+    std::vector<int> threads;
+    std::vector<bool> shared_clocks = {true, false};
+    double seconds = 2.0;
+    int block_len = 256;
+    uint32_t seed = 1;
+};
+
+// Square wave clock cable, high for the first half of the period
+struct ClockSource
+{
+    int period = kScaleSharedClockSamples;
+    int phase = 0;
+
+    float step()
+    {
+        const float volts = phase < period / 2 ? kMaximumVoltage : 0.0;
+        if (++phase == period)
+            phase = 0;
+
+        return volts;
+    }
+};
+
+// Threads meet here twice per frame, spinning with a yield like Rack's engine barrier
+class SpinBarrier
+{
+public:
+    explicit SpinBarrier(int count) : m_count(count) {}
+
+    void wait()
+    {
+        const unsigned step = m_step.load(std::memory_order_acquire);
+
+        if (m_waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == m_count) {
+            m_waiting.store(0, std::memory_order_relaxed);
+            m_step.fetch_add(1, std::memory_order_release);
+            return;
+        }
+
+        while (m_step.load(std::memory_order_acquire) == step)
+            std::this_thread::yield();
+    }
+
+private:
+    const int m_count;
+    std::atomic<int> m_waiting {0};
+    std::atomic<unsigned> m_step {0};
+};
+
+class ScaleEngine
+{
+public:
+    ScaleEngine(const std::vector<std::unique_ptr<HardSeqs>> &modules, int threads, bool is_shared_clock, uint32_t seed);
+    ~ScaleEngine();
+
+    // Steps all modules for block_len frames, returns the wall time and adds up the cache
+    // misses of all threads, -1 if any thread has no counter
+    int64_t stepBlock(int block_len, int64_t &misses);
+
+private:
+    // One per thread, on its own cache line
+    struct alignas(64) ThreadMisses
+    {
+        int64_t count = -1;
+        int64_t last = -1;
+    };
+
+    void runWorker(int thread_id);
+    void stepModules(int thread_id, const CacheMissCounter &counter);
+
+    std::vector<HardSeqs*> m_modules;
+    std::vector<ClockSource> m_clocks;
+    bool m_is_shared_clock;
+
+    Module::ProcessArgs m_args;
+    bool m_is_block_end = false;
+    bool m_is_stopping = false;
+    std::atomic<int> m_module_index {0};
+    SpinBarrier m_start_barrier;
+    SpinBarrier m_end_barrier;
+    std::vector<ThreadMisses> m_misses;
+    std::vector<std::thread> m_workers;
+    CacheMissCounter m_counter;
+};
+
+ScaleEngine::ScaleEngine(const std::vector<std::unique_ptr<HardSeqs>> &modules, int threads, bool is_shared_clock, uint32_t seed)
+    : m_is_shared_clock(is_shared_clock), m_start_barrier(threads), m_end_barrier(threads), m_misses(threads)
+{
+    for (const auto &module : modules)
+        m_modules.push_back(module.get());
+
+    m_clocks.resize(is_shared_clock ? 1 : modules.size());
+
+    if (!is_shared_clock) {
+        std::mt19937 rng(seed);
+
+        for (auto &clock : m_clocks) {
+            clock.period = std::uniform_int_distribution<int>(kScaleMinClockSamples, kScaleMaxClockSamples)(rng);
+            clock.phase = std::uniform_int_distribution<int>(0, clock.period - 1)(rng);
+        }
+    }
+
+    m_args.sampleRate = kScaleSampleRate;
+    m_args.sampleTime = 1.0f / kScaleSampleRate;
+    m_args.frame = 0;
+
+    for (int i = 1; i < threads; ++i)
+        m_workers.emplace_back([this, i] () { runWorker(i); });
+}
+
+ScaleEngine::~ScaleEngine()
+{
+    m_is_stopping = true;
+    m_start_barrier.wait();
+
+    for (auto &worker : m_workers)
+        worker.join();
+}
+
+void ScaleEngine::runWorker(int thread_id)
+{
+    // counts this thread only, so it has to be opened here
+    CacheMissCounter counter;
+
+    while (true) {
+        m_start_barrier.wait();
+        if (m_is_stopping)
+            return;
+
+        stepModules(thread_id, counter);
+        m_end_barrier.wait();
+    }
+}
+
+void ScaleEngine::stepModules(int thread_id, const CacheMissCounter &counter)
+{
+    const int count = static_cast<int>(m_modules.size());
+
+    while (true) {
+        const int i = m_module_index.fetch_add(1, std::memory_order_relaxed);
+        if (i >= count)
+            break;
+
+        m_modules[i]->process(m_args);
+    }
+
+    if (m_is_block_end)
+        m_misses[thread_id].count = counter.read();
+}
+
+int64_t ScaleEngine::stepBlock(int block_len, int64_t &misses)
+{
+    const int64_t start_ns = nowNs();
+
+    for (int frame = 0; frame < block_len; ++frame) {
+        // cables are copied on the main thread before the modules step
+        if (m_is_shared_clock) {
+            const float volts = m_clocks[0].step();
+            for (auto module : m_modules)
+                module->inputs[HardSeqs::INP_CLOCK].setVoltage(volts);
+        } else {
+            for (size_t i = 0; i < m_modules.size(); ++i)
+                m_modules[i]->inputs[HardSeqs::INP_CLOCK].setVoltage(m_clocks[i].step());
+        }
+
+        m_module_index.store(0, std::memory_order_relaxed);
+        m_is_block_end = frame == block_len - 1;
+
+        m_start_barrier.wait();
+        stepModules(0, m_counter);
+        m_end_barrier.wait();
+
+        m_args.frame++;
+    }
+
+    const int64_t block_ns = nowNs() - start_ns;
+
+    misses = 0;
+    for (auto &it : m_misses) {
+        if (it.count < 0 || it.last < 0 || misses < 0)
+            misses = -1;
+        else
+            misses += it.count - it.last;
+
+        it.last = it.count;
+    }
+
+    return block_ns;
+}
+
+static void runConfiguration(const ScaleOptions &options, int instances, int threads, bool is_shared_clock)
+{
+    std::vector<std::unique_ptr<HardSeqs>> modules;
+    for (int i = 0; i < instances; ++i) {
+        modules.push_back(createModule(options.seed + i));
+        modules.back()->m_is_running = true;
+    }
+
+    ScaleEngine engine(modules, threads, is_shared_clock, options.seed);
+
+    int64_t misses = 0;
+    for (int i = 0; i < kScaleWarmupBlocks; ++i)
+        engine.stepBlock(options.block_len, misses);
+
+    const int blocks = std::max(1, static_cast<int>(options.seconds * kScaleSampleRate / options.block_len));
+    const int64_t budget_ns = static_cast<int64_t>(options.block_len * 1e9 / kScaleSampleRate);
+
+    std::vector<int64_t> block_ns;
+    int64_t total_ns = 0;
+    int64_t total_misses = 0;
+    int over_budget = 0;
+
+    for (int i = 0; i < blocks; ++i) {
+        block_ns.push_back(engine.stepBlock(options.block_len, misses));
+        total_ns += block_ns.back();
+        over_budget += block_ns.back() > budget_ns;
+
+        if (misses < 0 || total_misses < 0)
+            total_misses = -1;
+        else
+            total_misses += misses;
+    }
+
+    std::sort(block_ns.begin(), block_ns.end());
+
+    const double samples = static_cast<double>(instances) * blocks * options.block_len;
+    const double audio_seconds = static_cast<double>(blocks) * options.block_len / kScaleSampleRate;
+
+    std::printf("hs_scale: %d instances, %d threads, %s clock: %.1fM samples/s, %.0f ns/sample, %.1fx realtime, "
+        "block p50 %lldus p99 %lldus max %lldus, %d of %d blocks over %lldus",
+        instances, threads, is_shared_clock ? "shared" : "independent",
+        samples / (total_ns * 1e-9) * 1e-6, total_ns / samples, audio_seconds / (total_ns * 1e-9),
+        static_cast<long long>(block_ns[block_ns.size() / 2] / 1000),
+        static_cast<long long>(block_ns[std::min(block_ns.size() - 1, block_ns.size() * 99 / 100)] / 1000),
+        static_cast<long long>(block_ns.back() / 1000),
+        over_budget, blocks, static_cast<long long>(budget_ns / 1000));
+
+    if (total_misses >= 0)
+        std::printf(", %.2f cache misses/sample", total_misses / samples);
+
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+static std::vector<int> parseList(const char *text)
+{
+    std::vector<int> values;
+
+    for (const char *it = text; *it; ) {
+        char *end = nullptr;
+        const long value = std::strtol(it, &end, 10);
+        if (end == it || value < 1)
+            return {};
+
+        values.push_back(static_cast<int>(value));
+        it = *end == ',' ? end + 1 : end;
+    }
+
+    return values;
+}
+
+static void printUsage()
+{
+    std::fprintf(stderr,
+        "usage: hs_scale [--instances 1,4,16,64,256,1024] [--threads 1,2,4] [--clock shared|independent|both]\n"
+        "                [--seconds 2] [--block 256] [--seed 1]\n"
+        "Threads default to powers of two up to the hardware thread count.\n");
+}
+
+int main(int argc, char **argv)
+{
+    ScaleOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *value = i + 1 < argc ? argv[i + 1] : "";
+        bool is_valid = true;
+
+        if (std::strcmp(argv[i], "--instances") == 0) {
+            options.instances = parseList(value);
+            is_valid = !options.instances.empty() && *std::max_element(options.instances.begin(), options.instances.end()) <= 1024;
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            options.threads = parseList(value);
+            is_valid = !options.threads.empty();
+        } else if (std::strcmp(argv[i], "--clock") == 0) {
+            if (std::strcmp(value, "shared") == 0)
+                options.shared_clocks = {true};
+            else if (std::strcmp(value, "independent") == 0)
+                options.shared_clocks = {false};
+            else
+                is_valid = std::strcmp(value, "both") == 0;
+        } else if (std::strcmp(argv[i], "--seconds") == 0) {
+            options.seconds = std::atof(value);
+            is_valid = options.seconds > 0.0;
+        } else if (std::strcmp(argv[i], "--block") == 0) {
+            options.block_len = std::atoi(value);
+            is_valid = options.block_len > 0;
+        } else if (std::strcmp(argv[i], "--seed") == 0) {
+            options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else {
+            is_valid = false;
+        }
+
+        if (!is_valid) {
+            printUsage();
+            return 1;
+        }
+
+        ++i;
+    }
+
+    if (options.threads.empty()) {
+        const int hw_threads = std::max(1u, std::thread::hardware_concurrency());
+        for (int threads = 1; threads <= hw_threads; threads *= 2)
+            options.threads.push_back(threads);
+    }
+
+    for (const int instances : options.instances)
+        for (const int threads : options.threads)
+            for (const bool is_shared_clock : options.shared_clocks)
+                runConfiguration(options, instances, threads, is_shared_clock);
+
+    return 0;
+}
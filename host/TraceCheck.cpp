@@ -0,0 +1,378 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+// hs_trace: golden traces of process() for regression checks of engine changes.
+//
+//   hs_trace record <file> [--seed 1] [--tables 64] [--seconds 10]
+//   hs_trace check <file> [--tolerance 0]
+//
+// Every table is one module built from seed + table index (random step table, LEN, direction,
+// clock rate and random generator) and played for the given time at 48 kHz with an InputStream
+// of the same seed on its inputs, plus random step, LEN and REPEAT edits between samples. After
+// each sample the trace holds the cabled inputs, every output, the lights and the playhead state.
+// check reads seed, tables and length from the file, plays the same run on this build and
+// reports the first differing value of every table, exit code 1 if any differ.
+//
+// Only values that changed since the previous sample are stored, see TraceWriter.
+
+#include "HostModule.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+constexpr const float kTraceSampleRate = 48000.0;
+constexpr const double kTraceEditChance = 1.0 / 4000;
+constexpr const uint32_t kTraceVersion = 1;
+
+static const int kTraceInputs[] = {HardSeqs::INP_RUN, HardSeqs::INP_POS, HardSeqs::INP_CLOCK, HardSeqs::INP_RST, HardSeqs::INP_FILL};
+constexpr const int kTraceInputCount = sizeof(kTraceInputs) / sizeof(kTraceInputs[0]);
+// Inputs, channel 0 of every output, the other channels of OUT_LANES and OUT_PLAYHEAD, lights,
+// then current step, start pos and loop counter
+constexpr const int kTraceStateCount = 3;
+constexpr const int kTraceValues = kTraceInputCount + HardSeqs::OUT_COUNT + (kValueLanes - 1) + 1 + HardSeqs::LED_COUNT + kTraceStateCount;
+
+static_assert(kTraceValues <= 64, "a sample's change mask is one uint64_t");
+
+struct TraceHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t seed;
+    uint32_t tables;
+    uint32_t values;
+    uint64_t samples;       // per table
+};
+
+struct TraceOptions
+{
+    uint32_t seed = 1;
+    uint32_t tables = 64;
+    double seconds = 10.0;
+    float tolerance = 0.0;
+};
+
+static void traceValues(HardSeqs &module, std::vector<float> &values)
+{
+    int n = 0;
+    for (const int input_id : kTraceInputs)
+        values[n++] = module.inputs[input_id].getVoltage();
+    for (int i = 0; i < HardSeqs::OUT_COUNT; ++i)
+        values[n++] = module.outputs[i].getVoltage();
+    for (int c = 1; c < kValueLanes; ++c)
+        values[n++] = module.outputs[HardSeqs::OUT_LANES].getVoltage(c);
+    values[n++] = module.outputs[HardSeqs::OUT_PLAYHEAD].getVoltage(1);
+    for (int i = 0; i < HardSeqs::LED_COUNT; ++i)
+        values[n++] = module.lights[i].value;
+
+    values[n++] = module.m_current_step;
+    values[n++] = module.m_start_pos;
+    values[n++] = module.m_cur_loop;
+}
+
+static std::string valueName(const HardSeqs &module, int index)
+{
+    if (index < kTraceInputCount)
+        return "input \"" + module.inputInfos[kTraceInputs[index]]->name + "\"";
+    index -= kTraceInputCount;
+
+    if (index < HardSeqs::OUT_COUNT)
+        return "output \"" + module.outputInfos[index]->name + "\"";
+    index -= HardSeqs::OUT_COUNT;
+
+    if (index < kValueLanes - 1)
+        return "output \"" + module.outputInfos[HardSeqs::OUT_LANES]->name + "\" channel " + std::to_string(index + 1);
+    index -= kValueLanes - 1;
+
+    if (index == 0)
+        return "output \"" + module.outputInfos[HardSeqs::OUT_PLAYHEAD]->name + "\" channel 1";
+    index -= 1;
+
+    if (index < HardSeqs::LED_COUNT)
+        return "light " + std::to_string(index);
+    index -= HardSeqs::LED_COUNT;
+
+    static const char *kStateNames[kTraceStateCount] = {"m_current_step", "m_start_pos", "m_cur_loop"};
+    return kStateNames[index];
+}
+
+// Samples are stored as records of how many samples kept all values, then a mask of the values
+// that changed in the next sample and those values. A zero mask ends a table on unchanged samples.
+class TraceWriter
+{
+public:
+    explicit TraceWriter(FILE *file) : m_file(file), m_last(kTraceValues) {}
+
+    void beginTable()
+    {
+        std::fill(m_last.begin(), m_last.end(), 0.0f);
+        m_skip = 0;
+    }
+
+    bool write(const std::vector<float> &values)
+    {
+        uint64_t mask = 0;
+        for (int i = 0; i < kTraceValues; ++i) {
+            if (std::memcmp(&values[i], &m_last[i], sizeof(float)) != 0)
+                mask |= uint64_t(1) << i;
+        }
+
+        if (mask == 0) {
+            if (m_skip == UINT32_MAX && !endTable())
+                return false;
+
+            m_skip = m_skip == UINT32_MAX ? 1 : m_skip + 1;
+            return true;
+        }
+
+        float changed[kTraceValues];
+        int count = 0;
+        for (int i = 0; i < kTraceValues; ++i) {
+            if ((mask >> i) & 1)
+                changed[count++] = m_last[i] = values[i];
+        }
+
+        const bool is_written = writeRecord(mask) && std::fwrite(changed, sizeof(float), count, m_file) == static_cast<size_t>(count);
+        m_skip = 0;
+        return is_written;
+    }
+
+    bool endTable()
+    {
+        return m_skip == 0 || writeRecord(0);
+    }
+
+private:
+    bool writeRecord(uint64_t mask)
+    {
+        return std::fwrite(&m_skip, sizeof(m_skip), 1, m_file) == 1 && std::fwrite(&mask, sizeof(mask), 1, m_file) == 1;
+    }
+
+    FILE *m_file;
+    std::vector<float> m_last;
+    uint32_t m_skip = 0;
+};
+
+class TraceReader
+{
+public:
+    explicit TraceReader(FILE *file) : m_file(file), m_values(kTraceValues), m_pending(kTraceValues) {}
+
+    void beginTable()
+    {
+        std::fill(m_values.begin(), m_values.end(), 0.0f);
+        m_skip = 0;
+        m_mask = 0;
+    }
+
+    // Values of the next sample, nullptr at the end of the file
+    const std::vector<float>* read()
+    {
+        if (m_skip == 0 && m_mask == 0) {
+            if (std::fread(&m_skip, sizeof(m_skip), 1, m_file) != 1 || std::fread(&m_mask, sizeof(m_mask), 1, m_file) != 1)
+                return nullptr;
+            if (m_skip == 0 && m_mask == 0)
+                return nullptr;
+
+            for (int i = 0; i < kTraceValues; ++i) {
+                if (((m_mask >> i) & 1) && std::fread(&m_pending[i], sizeof(float), 1, m_file) != 1)
+                    return nullptr;
+            }
+        }
+
+        if (m_skip > 0) {
+            m_skip--;
+            return &m_values;
+        }
+
+        for (int i = 0; i < kTraceValues; ++i) {
+            if ((m_mask >> i) & 1)
+                m_values[i] = m_pending[i];
+        }
+
+        m_mask = 0;
+        return &m_values;
+    }
+
+private:
+    FILE *m_file;
+    std::vector<float> m_values;
+    std::vector<float> m_pending;
+    uint32_t m_skip = 0;
+    uint64_t m_mask = 0;
+};
+
+// Plays every table, writing the trace, or comparing against it when is_check is set
+static int run(FILE *file, const TraceHeader &header, bool is_check, float tolerance)
+{
+    Module::ProcessArgs args;
+    args.sampleRate = kTraceSampleRate;
+    args.sampleTime = 1.0f / kTraceSampleRate;
+
+    std::vector<float> values(kTraceValues);
+    TraceWriter writer(file);
+    TraceReader reader(file);
+    uint32_t differing = 0;
+
+    for (uint32_t table = 0; table < header.tables; ++table) {
+        const uint32_t seed = header.seed + table;
+        auto module = createModule(seed);
+        module->m_is_running = true;
+
+        InputStream inputs(seed);
+        std::mt19937 edit_rng(seed);
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+        writer.beginTable();
+        reader.beginTable();
+        bool is_differing = false;
+
+        for (uint64_t sample = 0; sample < header.samples; ++sample) {
+            if (chance(edit_rng) < kTraceEditChance)
+                randomEdit(*module, edit_rng);
+
+            writeInputs(*module, inputs.next());
+            args.frame = static_cast<int64_t>(sample);
+            module->process(args);
+            traceValues(*module, values);
+
+            if (!is_check) {
+                if (!writer.write(values)) {
+                    std::fprintf(stderr, "hs_trace: cannot write the trace\n");
+                    return 2;
+                }
+
+                continue;
+            }
+
+            const std::vector<float> *expected = reader.read();
+            if (!expected) {
+                std::fprintf(stderr, "hs_trace: trace ended in table %u at sample %llu\n", table, static_cast<unsigned long long>(sample));
+                return 2;
+            }
+
+            for (int i = 0; i < kTraceValues && !is_differing; ++i) {
+                const float expected_value = (*expected)[i];
+                const bool is_equal = tolerance > 0.0 ? std::fabs(values[i] - expected_value) <= tolerance : values[i] == expected_value;
+                if (is_equal)
+                    continue;
+
+                std::printf("hs_trace: table %u (seed %u) differs at sample %llu, %s: expected %g, got %g\n",
+                    table, seed, static_cast<unsigned long long>(sample), valueName(*module, i).c_str(), expected_value, values[i]);
+                is_differing = true;
+            }
+        }
+
+        if (!is_check && !writer.endTable()) {
+            std::fprintf(stderr, "hs_trace: cannot write the trace\n");
+            return 2;
+        }
+
+        differing += is_differing;
+    }
+
+    if (is_check)
+        std::printf("hs_trace: %u of %u tables differ over %llu samples each\n", differing, header.tables, static_cast<unsigned long long>(header.samples));
+
+    return differing > 0 ? 1 : 0;
+}
+
+static void printUsage()
+{
+    std::fprintf(stderr,
+        "usage: hs_trace record <file> [--seed 1] [--tables 64] [--seconds 10]\n"
+        "       hs_trace check <file> [--tolerance 0]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3 || (std::strcmp(argv[1], "record") != 0 && std::strcmp(argv[1], "check") != 0)) {
+        printUsage();
+        return 2;
+    }
+
+    const bool is_check = std::strcmp(argv[1], "check") == 0;
+    const char *path = argv[2];
+    TraceOptions options;
+
+    for (int i = 3; i < argc; i += 2) {
+        const char *value = i + 1 < argc ? argv[i + 1] : "";
+        bool is_valid = true;
+
+        if (!is_check && std::strcmp(argv[i], "--seed") == 0) {
+            options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (!is_check && std::strcmp(argv[i], "--tables") == 0) {
+            options.tables = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            is_valid = options.tables > 0;
+        } else if (!is_check && std::strcmp(argv[i], "--seconds") == 0) {
+            options.seconds = std::atof(value);
+            is_valid = options.seconds > 0.0;
+        } else if (is_check && std::strcmp(argv[i], "--tolerance") == 0) {
+            options.tolerance = std::strtof(value, nullptr);
+            is_valid = options.tolerance >= 0.0;
+        } else {
+            is_valid = false;
+        }
+
+        if (!is_valid) {
+            printUsage();
+            return 2;
+        }
+    }
+
+    FILE *file = std::fopen(path, is_check ? "rb" : "wb");
+    if (!file) {
+        std::fprintf(stderr, "hs_trace: cannot open %s\n", path);
+        return 2;
+    }
+
+    TraceHeader header;
+    int result = 0;
+
+    if (is_check) {
+        if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, "HSTRACE", 8) != 0
+            || header.version != kTraceVersion || header.values != kTraceValues) {
+            std::fprintf(stderr, "hs_trace: %s is not a version %u trace of %d values\n", path, kTraceVersion, kTraceValues);
+            result = 2;
+        } else {
+            result = run(file, header, true, options.tolerance);
+        }
+    } else {
+        std::memcpy(header.magic, "HSTRACE", 8);
+        header.version = kTraceVersion;
+        header.seed = options.seed;
+        header.tables = options.tables;
+        header.values = kTraceValues;
+        header.samples = static_cast<uint64_t>(options.seconds * kTraceSampleRate);
+
+        if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+            std::fprintf(stderr, "hs_trace: cannot write the trace\n");
+            result = 2;
+        } else {
+            result = run(file, header, false, 0.0);
+        }
+    }
+
+    std::fclose(file);
+    return result;
+}
@@ -0,0 +1,449 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+// The part of the Rack 2 API the HardSeqs engine sources use, for the headless host in this
+// directory: Module, Param, Port, Light, ParamQuantity, expanders, dsp::RingBuffer,
+// dsp::PulseGenerator, simd::float_4 and simd::int32_4. No window, GL, engine or plugin loading. Semantics
+// follow Rack where process() can observe them, e.g. Port::setChannels() keeps a disconnected
+// port at 0 channels, so the host connects ports by setting Port::channels as the engine does.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <emmintrin.h>
+
+#include "jansson.h"
+
+#define PORT_MAX_CHANNELS 16
+
+namespace rack {
+
+inline int clamp(int x, int a, int b)
+{
+    return std::max(std::min(x, b), a);
+}
+
+inline float clamp(float x, float a = 0.f, float b = 1.f)
+{
+    return std::fmax(std::fmin(x, b), a);
+}
+
+namespace simd {
+
+// SSE vector of 4 ints like Rack's simd::Vector<int32_t, 4>
+struct int32_4
+{
+    union {
+        __m128i v;
+        int32_t s[4];
+    };
+
+    int32_4() = default;
+    int32_4(__m128i v) : v(v) {}
+    int32_4(int32_t x) : v(_mm_set1_epi32(x)) {}
+    int32_4(int32_t x0, int32_t x1, int32_t x2, int32_t x3) : v(_mm_setr_epi32(x0, x1, x2, x3)) {}
+
+    int32_t& operator[](int i) { return s[i]; }
+    const int32_t& operator[](int i) const { return s[i]; }
+};
+
+inline int32_4 operator+(const int32_4 &a, const int32_4 &b) { return int32_4(_mm_add_epi32(a.v, b.v)); }
+inline int32_4 operator-(const int32_4 &a, const int32_4 &b) { return int32_4(_mm_sub_epi32(a.v, b.v)); }
+inline int32_4 operator&(const int32_4 &a, const int32_4 &b) { return int32_4(_mm_and_si128(a.v, b.v)); }
+inline int32_4 operator^(const int32_4 &a, const int32_4 &b) { return int32_4(_mm_xor_si128(a.v, b.v)); }
+// logical shift, as in Rack
+inline int32_4 operator>>(const int32_4 &a, const int &b) { return int32_4(_mm_srl_epi32(a.v, _mm_cvtsi32_si128(b))); }
+
+// SSE vector of 4 floats like Rack's simd::Vector<float, 4>
+struct float_4
+{
+    union {
+        __m128 v;
+        float s[4];
+    };
+
+    float_4() = default;
+    float_4(__m128 v) : v(v) {}
+    float_4(float x) : v(_mm_set1_ps(x)) {}
+    float_4(float x0, float x1, float x2, float x3) : v(_mm_setr_ps(x0, x1, x2, x3)) {}
+    // converts the values, as Rack's Vector<float, 4>(Vector<int32_t, 4>)
+    float_4(const int32_4 &x) : v(_mm_cvtepi32_ps(x.v)) {}
+
+    static float_4 zero() { return float_4(_mm_setzero_ps()); }
+    static float_4 load(const float *x) { return float_4(_mm_loadu_ps(x)); }
+    void store(float *x) const { _mm_storeu_ps(x, v); }
+
+    float& operator[](int i) { return s[i]; }
+    const float& operator[](int i) const { return s[i]; }
+};
+
+inline float_4 operator+(const float_4 &a, const float_4 &b) { return float_4(_mm_add_ps(a.v, b.v)); }
+inline float_4 operator-(const float_4 &a, const float_4 &b) { return float_4(_mm_sub_ps(a.v, b.v)); }
+inline float_4 operator*(const float_4 &a, const float_4 &b) { return float_4(_mm_mul_ps(a.v, b.v)); }
+inline float_4 operator/(const float_4 &a, const float_4 &b) { return float_4(_mm_div_ps(a.v, b.v)); }
+inline float_4& operator+=(float_4 &a, const float_4 &b) { return a = a + b; }
+inline float_4& operator-=(float_4 &a, const float_4 &b) { return a = a - b; }
+inline float_4& operator*=(float_4 &a, const float_4 &b) { return a = a * b; }
+inline float_4& operator/=(float_4 &a, const float_4 &b) { return a = a / b; }
+
+// comparisons give all-ones lanes where true, as in Rack
+inline float_4 operator<(const float_4 &a, const float_4 &b) { return float_4(_mm_cmplt_ps(a.v, b.v)); }
+inline float_4 operator<=(const float_4 &a, const float_4 &b) { return float_4(_mm_cmple_ps(a.v, b.v)); }
+
+inline int movemask(const float_4 &a) { return _mm_movemask_ps(a.v); }
+inline float_4 ifelse(const float_4 &mask, const float_4 &a, const float_4 &b)
+{
+    return float_4(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+}
+inline float_4 fabs(const float_4 &a) { return float_4(_mm_andnot_ps(_mm_set1_ps(-0.f), a.v)); }
+
+inline float_4 fmin(const float_4 &a, const float_4 &b) { return float_4(_mm_min_ps(a.v, b.v)); }
+inline float_4 fmax(const float_4 &a, const float_4 &b) { return float_4(_mm_max_ps(a.v, b.v)); }
+
+inline float_4 clamp(const float_4 &x, const float_4 &a = 0.f, const float_4 &b = 1.f)
+{
+    return fmin(fmax(x, a), b);
+}
+
+} // namespace simd
+
+namespace dsp {
+
+// Lock-free for one producer and one consumer, S must be a power of two
+template <typename T, size_t S>
+struct RingBuffer
+{
+    std::atomic<size_t> start {0};
+    std::atomic<size_t> end {0};
+    T data[S];
+
+    void push(T t)
+    {
+        data[end % S] = t;
+        end++;
+    }
+
+    T shift()
+    {
+        T t = data[start % S];
+        start++;
+        return t;
+    }
+
+    void clear() { start = end.load(); }
+    bool empty() const { return start >= end; }
+    bool full() const { return end - start >= S; }
+    size_t size() const { return end - start; }
+    size_t capacity() const { return S - size(); }
+};
+
+struct PulseGenerator
+{
+    float remaining = 0.f;
+
+    void reset() { remaining = 0.f; }
+
+    bool process(float deltaTime)
+    {
+        if (remaining > 0.f) {
+            remaining -= deltaTime;
+            return true;
+        }
+
+        return false;
+    }
+
+    void trigger(float duration = 1e-3f)
+    {
+        if (duration > remaining)
+            remaining = duration;
+    }
+};
+
+} // namespace dsp
+
+namespace plugin {
+
+struct Model {};
+struct Plugin {};
+
+} // namespace plugin
+
+namespace engine {
+
+struct Module;
+
+struct Param
+{
+    float value = 0.f;
+
+    float getValue() { return value; }
+    void setValue(float value) { this->value = value; }
+};
+
+struct Port
+{
+    float voltages[PORT_MAX_CHANNELS] = {};
+    // 0 = disconnected, set by the host
+    uint8_t channels = 0;
+
+    void setVoltage(float voltage, int channel = 0) { voltages[channel] = voltage; }
+    float getVoltage(int channel = 0) { return voltages[channel]; }
+    float getPolyVoltage(int channel) { return isMonophonic() ? getVoltage(0) : getVoltage(channel); }
+    float getNormalVoltage(float normalVoltage, int channel = 0) { return isConnected() ? getVoltage(channel) : normalVoltage; }
+
+    template <typename T>
+    T getVoltageSimd(int firstChannel) { return T::load(&voltages[firstChannel]); }
+    template <typename T>
+    void setVoltageSimd(T voltage, int firstChannel) { voltage.store(&voltages[firstChannel]); }
+
+    void setChannels(int channels)
+    {
+        // a disconnected port stays at 0 channels
+        if (this->channels == 0)
+            return;
+
+        for (int c = channels; c < this->channels; c++)
+            voltages[c] = 0.f;
+
+        this->channels = std::max(channels, 1);
+    }
+
+    int getChannels() { return channels; }
+    bool isConnected() { return channels > 0; }
+    bool isMonophonic() { return channels == 1; }
+    bool isPolyphonic() { return channels > 1; }
+};
+
+struct Input : Port {};
+struct Output : Port {};
+
+struct Light
+{
+    float value = 0.f;
+
+    void setBrightness(float brightness) { value = brightness; }
+    float getBrightness() { return value; }
+};
+
+struct ParamQuantity
+{
+    Module *module = nullptr;
+    int paramId = -1;
+    float minValue = 0.f;
+    float maxValue = 1.f;
+    float defaultValue = 0.f;
+    std::string name;
+    std::string unit;
+    float displayBase = 0.f;
+    float displayMultiplier = 1.f;
+    float displayOffset = 0.f;
+    bool snapEnabled = false;
+
+    virtual ~ParamQuantity() {}
+
+    void setValue(float value);
+    float getValue();
+    float getMinValue() { return minValue; }
+    float getMaxValue() { return maxValue; }
+    float getDefaultValue() { return defaultValue; }
+};
+
+struct SwitchQuantity : ParamQuantity
+{
+    std::vector<std::string> labels;
+};
+
+struct PortInfo
+{
+    std::string name;
+};
+
+struct LightInfo
+{
+    std::string name;
+};
+
+struct Expander
+{
+    int64_t moduleId = -1;
+    Module *module = nullptr;
+    void *producerMessage = nullptr;
+    void *consumerMessage = nullptr;
+    bool messageFlipRequested = false;
+
+    void requestMessageFlip() { messageFlipRequested = true; }
+};
+
+struct Module
+{
+    plugin::Model *model = nullptr;
+    int64_t id = -1;
+
+    std::vector<Param> params;
+    std::vector<Input> inputs;
+    std::vector<Output> outputs;
+    std::vector<Light> lights;
+
+    std::vector<ParamQuantity*> paramQuantities;
+    std::vector<PortInfo*> inputInfos;
+    std::vector<PortInfo*> outputInfos;
+    std::vector<LightInfo*> lightInfos;
+
+    Expander leftExpander;
+    Expander rightExpander;
+
+    struct ProcessArgs {
+        float sampleRate;
+        float sampleTime;
+        int64_t frame;
+    };
+
+    struct AddEvent {};
+    struct RemoveEvent {};
+
+    Module() = default;
+    Module(const Module&) = delete;
+    Module& operator=(const Module&) = delete;
+
+    virtual ~Module()
+    {
+        for (auto quantity : paramQuantities)
+            delete quantity;
+        for (auto info : inputInfos)
+            delete info;
+        for (auto info : outputInfos)
+            delete info;
+        for (auto info : lightInfos)
+            delete info;
+    }
+
+    void config(int numParams, int numInputs, int numOutputs, int numLights = 0)
+    {
+        params.resize(numParams);
+        inputs.resize(numInputs);
+        outputs.resize(numOutputs);
+        lights.resize(numLights);
+        paramQuantities.resize(numParams);
+        inputInfos.resize(numInputs);
+        outputInfos.resize(numOutputs);
+        lightInfos.resize(numLights);
+    }
+
+    template <class TParamQuantity = ParamQuantity>
+    TParamQuantity* configParam(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "",
+        std::string unit = "", float displayBase = 0.f, float displayMultiplier = 1.f, float displayOffset = 0.f)
+    {
+        delete paramQuantities[paramId];
+
+        TParamQuantity *q = new TParamQuantity;
+        q->module = this;
+        q->paramId = paramId;
+        q->minValue = minValue;
+        q->maxValue = maxValue;
+        q->defaultValue = defaultValue;
+        q->name = name;
+        q->unit = unit;
+        q->displayBase = displayBase;
+        q->displayMultiplier = displayMultiplier;
+        q->displayOffset = displayOffset;
+        paramQuantities[paramId] = q;
+
+        params[paramId].value = defaultValue;
+        return q;
+    }
+
+    template <class TSwitchQuantity = SwitchQuantity>
+    TSwitchQuantity* configSwitch(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "",
+        std::vector<std::string> labels = {})
+    {
+        TSwitchQuantity *q = configParam<TSwitchQuantity>(paramId, minValue, maxValue, defaultValue, name);
+        q->snapEnabled = true;
+        q->labels = labels;
+        return q;
+    }
+
+    PortInfo* configInput(int portId, std::string name = "")
+    {
+        delete inputInfos[portId];
+        inputInfos[portId] = new PortInfo {name};
+        return inputInfos[portId];
+    }
+
+    PortInfo* configOutput(int portId, std::string name = "")
+    {
+        delete outputInfos[portId];
+        outputInfos[portId] = new PortInfo {name};
+        return outputInfos[portId];
+    }
+
+    LightInfo* configLight(int lightId, std::string name = "")
+    {
+        delete lightInfos[lightId];
+        lightInfos[lightId] = new LightInfo {name};
+        return lightInfos[lightId];
+    }
+
+    Param& getParam(int index) { return params[index]; }
+    Input& getInput(int index) { return inputs[index]; }
+    Output& getOutput(int index) { return outputs[index]; }
+    Light& getLight(int index) { return lights[index]; }
+    ParamQuantity* getParamQuantity(int index) { return paramQuantities[index]; }
+    Expander& getLeftExpander() { return leftExpander; }
+    Expander& getRightExpander() { return rightExpander; }
+
+    virtual void process(const ProcessArgs &args) {}
+    virtual json_t* dataToJson() { return nullptr; }
+    virtual void dataFromJson(json_t *rootJ) {}
+    virtual void onAdd(const AddEvent &e) {}
+    virtual void onRemove(const RemoveEvent &e) {}
+};
+
+inline void ParamQuantity::setValue(float value)
+{
+    module->params[paramId].setValue(value);
+}
+
+inline float ParamQuantity::getValue()
+{
+    return module->params[paramId].getValue();
+}
+
+} // namespace engine
+
+using engine::Module;
+using engine::ParamQuantity;
+using plugin::Model;
+using plugin::Plugin;
+
+namespace asset {
+
+// Relative to the host's working directory
+std::string user(std::string filename);
+
+} // namespace asset
+
+} // namespace rack
@@ -0,0 +1,215 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#include "ControlSocket.hpp"
+#include "HardSeqs.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(ARCH_LIN) || defined(ARCH_MAC)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// How often the socket thread checks for stop() while idle
+constexpr const int kControlPollMs = 50;
+constexpr const size_t kControlMaxDatagram = sizeof(ControlHeader) + sizeof(PackedPattern);
+
+ControlSocket& ControlSocket::shared()
+{
+    static ControlSocket socket;
+    return socket;
+}
+
+ControlSocket::~ControlSocket()
+{
+    stop();
+}
+
+void ControlSocket::attach(int64_t module_id, ControlInbox *inbox)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [inbox] (const Entry &entry) { return entry.inbox == inbox; });
+    if (it != m_entries.end())
+        it->module_id = module_id;
+    else
+        m_entries.push_back({module_id, inbox});
+
+    lock.unlock();
+    start();
+}
+
+void ControlSocket::detach(ControlInbox *inbox)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+        [inbox] (const Entry &entry) { return entry.inbox == inbox; }), m_entries.end());
+
+    const bool is_empty = m_entries.empty();
+    lock.unlock();
+
+    if (is_empty)
+        stop();
+}
+
+void ControlSocket::start()
+{
+    #if defined(ARCH_LIN) || defined(ARCH_MAC)
+    if (m_thread.joinable())
+        return;
+
+    const int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return;
+
+    const auto path = asset::user("HardSeqs.sock");
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::fprintf(stderr, "hardseqs control: socket path too long: %s\n", path.c_str());
+        close(fd);
+        return;
+    }
+
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // a stale socket file from a crashed session would make bind() fail
+    unlink(path.c_str());
+
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::fprintf(stderr, "hardseqs control: cannot bind %s\n", path.c_str());
+        close(fd);
+        return;
+    }
+
+    m_is_stopping.store(false);
+    m_thread = std::thread([this, fd] () { run(fd); });
+    #endif
+}
+
+void ControlSocket::stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    m_is_stopping.store(true);
+    m_thread.join();
+}
+
+void ControlSocket::run(int fd)
+{
+    #if defined(ARCH_LIN) || defined(ARCH_MAC)
+    uint8_t buffer[kControlMaxDatagram];
+
+    while (!m_is_stopping.load()) {
+        pollfd poll_fd {fd, POLLIN, 0};
+        if (poll(&poll_fd, 1, kControlPollMs) <= 0)
+            continue;
+
+        const auto size = recv(fd, buffer, sizeof(buffer), 0);
+        if (size > 0)
+            handle(buffer, static_cast<size_t>(size));
+    }
+
+    close(fd);
+    unlink(asset::user("HardSeqs.sock").c_str());
+    #endif
+}
+
+static bool isFinite(const PackedStep &step)
+{
+    for (const auto value : step.values) {
+        if (!std::isfinite(value))
+            return false;
+    }
+
+    return true;
+}
+
+void ControlSocket::handle(const uint8_t *data, size_t size)
+{
+    if (size < sizeof(ControlHeader))
+        return;
+
+    ControlHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    ControlMessage message;
+    message.command = header.command;
+    message.index = header.index;
+
+    const auto *payload = data + sizeof(header);
+    const auto payload_size = size - sizeof(header);
+
+    if (header.command == CONTROL_SET_STEPS || header.command == CONTROL_SET_BANK_SLOT) {
+        if (payload_size != sizeof(PackedPattern))
+            return;
+        if (header.command == CONTROL_SET_BANK_SLOT && header.index >= kSongSlots)
+            return;
+
+        std::memcpy(&message.pattern, payload, sizeof(PackedPattern));
+    } else if (header.command == CONTROL_SET_STEP) {
+        if (payload_size != sizeof(PackedStep) || header.index >= kPackedSteps)
+            return;
+
+        std::memcpy(&message.pattern.steps[0], payload, sizeof(PackedStep));
+    } else if (header.command == CONTROL_FAST_FORWARD) {
+        if (payload_size != sizeof(uint64_t))
+            return;
+
+        std::memcpy(&message.ticks, payload, sizeof(uint64_t));
+    } else {
+        return;
+    }
+
+    int checked_steps = kPackedSteps;
+    if (header.command == CONTROL_SET_STEP)
+        checked_steps = 1;
+    else if (header.command == CONTROL_FAST_FORWARD)
+        checked_steps = 0;
+    for (int i = 0; i < checked_steps; ++i) {
+        if (!isFinite(message.pattern.steps[i]))
+            return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = std::find_if(m_entries.begin(), m_entries.end(),
+        [&header] (const Entry &entry) { return entry.module_id == header.module_id; });
+    if (it == m_entries.end())
+        return;
+
+    // RingBuffer::push() does not check for room and would overwrite unread messages
+    if (it->inbox->full()) {
+        std::fprintf(stderr, "hardseqs control: queue full, module %lld\n", static_cast<long long>(header.module_id));
+        return;
+    }
+
+    it->inbox->push(message);
+}
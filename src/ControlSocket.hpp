@@ -0,0 +1,105 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <rack.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PackedPattern.hpp"
+
+// Optional local control endpoint. While at least one instance has remote control enabled,
+// a background thread listens on the Unix datagram socket <Rack user dir>/HardSeqs.sock.
+// Each datagram is one ControlHeader followed by its payload, little-endian:
+//
+//   CONTROL_SET_STEPS      PackedPattern, replaces the step table
+//   CONTROL_SET_BANK_SLOT  PackedPattern, replaces song bank slot `index`
+//   CONTROL_SET_STEP       PackedStep, replaces step `index`
+//   CONTROL_FAST_FORWARD   uint64_t, puts the playhead where it would be that many sequencer
+//                          ticks after a reset
+//
+// Messages are validated on the socket thread and queued per instance. The instance's widget
+// applies them on the UI thread, so step edits can be undone. Not available on Windows.
+
+constexpr const int kControlQueueSize = 32;
+
+enum ControlCommand : uint8_t {
+    CONTROL_SET_STEPS = 1,
+    CONTROL_SET_BANK_SLOT,
+    CONTROL_SET_STEP,
+    CONTROL_FAST_FORWARD
+};
+
+struct ControlHeader
+{
+    int64_t module_id;      // Rack module id, shown in the module's context menu
+    uint8_t command;
+    uint8_t index;          // bank slot or step, unused for CONTROL_SET_STEPS
+    uint8_t reserved[6];
+};
+
+static_assert(sizeof(ControlHeader) == 16, "ControlHeader layout is part of the protocol");
+
+// Validated message, a single step travels in pattern.steps[0]
+struct ControlMessage
+{
+    uint8_t command = 0;
+    uint8_t index = 0;
+    uint64_t ticks = 0;
+    PackedPattern pattern;
+};
+
+// Written by the socket thread only, read by the instance's widget only
+using ControlInbox = rack::dsp::RingBuffer<ControlMessage, kControlQueueSize>;
+
+class ControlSocket
+{
+public:
+    static ControlSocket& shared();
+
+    // Both take the registry lock and may start or join the socket thread, UI thread only.
+    // The inbox must stay alive until it is detached.
+    void attach(int64_t module_id, ControlInbox *inbox);
+    void detach(ControlInbox *inbox);
+
+private:
+    struct Entry {
+        int64_t module_id;
+        ControlInbox *inbox;
+    };
+
+    ControlSocket() = default;
+    ~ControlSocket();
+
+    void start();
+    void stop();
+    void run(int fd);
+    void handle(const uint8_t *data, size_t size);
+
+    std::mutex m_mutex;
+    std::vector<Entry> m_entries;
+
+    std::thread m_thread;
+    std::atomic<bool> m_is_stopping {false};
+};
@@ -0,0 +1,46 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+// Messages exchanged between adjacent HardSeqs through Rack's expander double buffers.
+// Every module writes both messages on every sample, the receiver reads the copy flipped
+// in after the previous engine step, so each hop adds one sample of latency.
+
+// Left to right: transport events after edge detection, plus the chain playhead
+struct BusMessage
+{
+    bool is_clock_edge = false;
+    bool is_clock_high = false;
+    bool is_reset = false;
+    bool is_run_trigger = false;
+    bool is_running = false;
+
+    // Chain playhead for this edge, chain_len = 0 when the sender is not part of a chain
+    int chain_pos = 0;
+    int chain_len = 0;
+    // First chain step owned by the receiver
+    int chain_offset = 0;
+};
+
+// Right to left: chain steps owned by the sender and everything chained to its right
+struct BusReply
+{
+    int chain_len_right = 0;
+};
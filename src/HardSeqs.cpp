@@ -18,7 +18,12 @@
  */
 
 #include "HardSeqs.hpp"
+#include "PatternLibrary.hpp"
+#include "PatternLinks.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include "jansson.h"
 
@@ -28,6 +33,7 @@
 constexpr const float kStepEnabled = 0.1;
 constexpr const float kStepPlaying = 0.9;
 constexpr const float kModOutputDenum = 10.0;
+constexpr const int kRecMaxSamples = 1 << 30;
 
 template<typename T>
 T clamp(const T &v, const T &val_max, const T &val_min) {
@@ -51,13 +57,33 @@ HardSeqs::HardSeqs()
     configParam(PARAM_LEN, 0.0, 16.0, 16.0, "Sequence length");
     configParam(PARAM_REPEAT_N, 0.0, 4.0, 0.0, "Repeat times");
     configParam(PARAM_LABEL, 0.0, 11.0, 0.0, "Instrument label");
+    configSwitch(PARAM_ALGO_MODE, 0.0, ALGO_COUNT - 1, ALGO_MANUAL, "Gate mode", {"Manual", "Euclidean", "Density ramp", "Markov"});
+    configParam(PARAM_ALGO_FILL, 0.0, 16.0, 4.0, "Algorithmic fill");
+    configParam(PARAM_ALGO_SHIFT, 0.0, 15.0, 0.0, "Algorithmic shift / Markov bias");
+    configParam(PARAM_MORPH, 0.0, 1.0, 0.0, "Morph to target", "%", 0.0, 100.0);
+    configSwitch(PARAM_CLOCK_SOURCE, 0.0, 1.0, 0.0, "Clock source", {"External", "Internal"});
+    configParam(PARAM_BPM, 30.0, 300.0, 120.0, "Internal clock tempo", " BPM");
+    configParam(PARAM_GLIDE_TIME, 0.0, 2.0, 0.1, "Glide time", " ms", 0.0, 1000.0);
+    configSwitch(PARAM_CLOCK_DIV, 0.0, kClockDivisions.size() - 1, kClockDefaultDivision, "Internal clock steps per beat", {"1", "2", "3", "4", "6", "8"});
+    configSwitch(PARAM_CLOCK_RATE, 0.0, kClockRates.size() - 1, kClockDefaultRate, "Ticks per clock", {"1/4", "1/3", "1/2", "1", "2", "3", "4"});
 
     configParam(PARAM_STEP_PROB, 0.0, 100.0, kStepDefaultProb, "Probability");
     configParam(PARAM_STEP_MOD1, -100.0, 100.0, kStepDefaultMod1, "Mod1");
     configParam(PARAM_STEP_MOD2, -100.0, 100.0, kStepDefaultMod2, "Mod2");
     configParam(PARAM_STEP_MOD3, -100.0, 100.0, kStepDefaultMod3, "Mod3");
+    configParam(PARAM_STEP_ACCENT, 0.0, 100.0, 0.0, "Accent");
+    configSwitch(PARAM_REC, 0.0, 1.0, 0.0, "Record", {"Off", "On"});
+    configSwitch(PARAM_DIRECTION, 0.0, DIR_COUNT - 1, DIR_FORWARD, "Direction", {"Forward", "Reverse", "Ping-pong", "Odd/even", "Shuffle", "Random walk", "CV address"});
+    configSwitch(PARAM_STEP_COND, 0.0, TRIG_COUNT - 1, TRIG_ALWAYS, "Trig condition", {"Always", "Fill", "Not fill", "First loop", "Not first loop", "Previous step fired", "Previous step silent", "Cycle A:B"});
+    configParam(PARAM_STEP_CYCLE_A, 1.0, kMaxCycleLen, 1.0, "Cycle A");
+    configParam(PARAM_STEP_CYCLE_B, 1.0, kMaxCycleLen, 1.0, "Cycle B");
+
+    for (int i = PARAM_STEP_LANE5; i <= PARAM_STEP_LANE8; ++i)
+        configParam(i, -100.0, 100.0, 0.0, "Lane" + std::to_string(valueLane(i) + 1));
     configParam(PARAM_STEP_ELEN, 0.0, 5.0, kStepDefaultElen, "Play each n-time length");
     configParam(PARAM_STEP_ENABLED, 0.0, 1.0, 0.0, "Gate");
+    configParam(PARAM_STEP_GLIDE, 0.0, 1.0, 0.0, "Glide into step");
+    configParam(PARAM_STEP_DURATION, 1.0, kMaxStepTicks, 1.0, "Step duration", " ticks");
     
     for (int i = PARAM_STEP_EACH1; i <= PARAM_STEP_EACH5; ++i)
         configParam(i, 0.0, 1.0, 0.0, "Play each " + std::to_string(i - PARAM_STEP_EACH1 + 1) + "-th iteration");
@@ -70,6 +96,19 @@ HardSeqs::HardSeqs()
     configInput(INP_POS, "Start pos modulation");
     configInput(INP_CLOCK, "Clock");
     configInput(INP_RST, "Reset");
+    configInput(INP_ALGO_FILL, "Algorithmic fill modulation");
+    configInput(INP_ALGO_SHIFT, "Algorithmic shift modulation");
+    configInput(INP_MORPH, "Morph modulation, 10V = target");
+    configInput(INP_PROB, "Step probability offset, 1V = 10% (poly: channel per step)");
+    configInput(INP_MOD1, "Mod1 offset (poly: channel per step)");
+    configInput(INP_MOD2, "Mod2 offset (poly: channel per step)");
+    configInput(INP_MOD3, "Mod3 offset (poly: channel per step)");
+    configInput(INP_LEN, "Sequence length, 10V = 16 steps");
+    configInput(INP_ELEN, "Step ELEN, 2V per count (poly: channel per step)");
+    configInput(INP_REC, "Record gate");
+    configInput(INP_REC_CV, "Record CV (10V = lane value 100)");
+    configInput(INP_FILL, "Fill gate");
+    configInput(INP_ADDR, "Step address in CV address mode, 10V = 16 steps");
 
     // setup output
     for (int i = OUT_STEP1; i <= OUT_STEP16; ++i)
@@ -79,8 +118,41 @@ HardSeqs::HardSeqs()
     configOutput(OUT_MOD1, "Out mod1");
     configOutput(OUT_MOD2, "Out mod2");
     configOutput(OUT_MOD3, "Out mod3");
+    configOutput(OUT_CLOCK, "Clock (internal clock or input thru)");
+    configOutput(OUT_LANES, "Value lanes (poly: mod1..3, accent, lane5..8)");
+    configOutput(OUT_EOL, "End of loop trigger");
+    configOutput(OUT_END_ELEN, "End of ELEN cycle trigger");
+    configOutput(OUT_END_REPEAT, "End of repeat trigger");
+    configOutput(OUT_PLAYHEAD, "Playhead (poly: step as the POS input reads it, loop at 1V per loop)");
+
+    outputs[OUT_PLAYHEAD].setChannels(2);
 
     getParam(PARAM_STEP1 + m_selected_step).setValue(1.0);
+
+    shuffleMorphThresholds();
+    rollProbabilityMask();
+
+    publishSongSnapshot();
+    m_cv_elen.fill(-1);
+    m_link_version.store(kLinkReleased);
+    beginLoop(sequenceLength(false));
+
+    leftExpander.producerMessage = &m_bus_from_left[0];
+    leftExpander.consumerMessage = &m_bus_from_left[1];
+    rightExpander.producerMessage = &m_bus_from_right[0];
+    rightExpander.consumerMessage = &m_bus_from_right[1];
+}
+
+HardSeqs::~HardSeqs()
+{
+    // the module is out of the engine, nothing plays a group version any more
+    PatternLinks::shared().remove(&m_link_version);
+
+    if (m_is_remote)
+        ControlSocket::shared().detach(m_control_inbox.get());
+
+    delete m_song_tables.load();
+    delete m_morph_steps.load();
 }
 
 void HardSeqs::setSelectedStep(int step)
@@ -103,36 +175,55 @@ void HardSeqs::setSelectedStep(int step)
     getParam(PARAM_STEP_EACH5).setValue(static_cast<float>(local_entry.each_n[4]));
     // Each step probability
     getParam(PARAM_STEP_PROB).setValue(static_cast<float>(local_entry.prob));
-    getParam(PARAM_STEP_MOD1).setValue(local_entry.mod1);
-    getParam(PARAM_STEP_MOD2).setValue(local_entry.mod2);
-    getParam(PARAM_STEP_MOD3).setValue(local_entry.mod3);
+    for (int lane = 0; lane < kValueLanes; ++lane)
+        getParam(laneParam(lane)).setValue(local_entry.values[lane]);
     getParam(PARAM_STEP_ELEN).setValue(local_entry.len_each_n);
+    getParam(PARAM_STEP_GLIDE).setValue(static_cast<float>(local_entry.is_glide));
+    getParam(PARAM_STEP_DURATION).setValue(static_cast<float>(local_entry.duration));
+    getParam(PARAM_STEP_COND).setValue(static_cast<float>(local_entry.condition));
+    getParam(PARAM_STEP_CYCLE_A).setValue(static_cast<float>(local_entry.cycle_a));
+    getParam(PARAM_STEP_CYCLE_B).setValue(static_cast<float>(local_entry.cycle_b));
 }
 
 void HardSeqs::process(const ProcessArgs &args)
 {
-    const auto cv_pos = inputs[INP_POS].getVoltage();
-    const auto cv_clock = inputs[INP_CLOCK].getVoltage();
-    const auto cv_reset = inputs[INP_RST].getVoltage();
+    #ifdef HS_PROFILE
+    ProfileScope profile_scope(m_profile);
+    #endif
 
-    m_cv_clock.update(cv_clock);
-    m_cv_reset.update(cv_reset);
+    if (m_is_reroll_pending.load(std::memory_order_relaxed))
+        rerollProbabilityMask();
 
-    // cv run
-    if (inputs[INP_RUN].isConnected())
-    {
-        m_cv_run.update(inputs[INP_RUN].getVoltage());
+    const int link_group = m_link_group.load(std::memory_order_relaxed);
+    if (link_group >= 0)
+        applyLinkedSteps(link_group);
+    else if (m_link_pattern)
+        releaseLinkedSteps();
 
-        // sequence will turn off automatically if PARAM_REPEAT_N is set, so we ignore signal if we already running
-        bool is_enabled_and_limit_repeat = m_is_running && getParam(PARAM_REPEAT_N).value != 0.0;
+    if (m_is_fast_forward_pending.load(std::memory_order_relaxed) && m_is_fast_forward_pending.exchange(false, std::memory_order_acquire))
+        fastForward(m_fast_forward_ticks.load(std::memory_order_relaxed));
 
-        if (m_cv_run.newTrigger() && is_enabled_and_limit_repeat == false) {
-            m_is_running = !m_is_running;
-            lights[LED_IS_RUNNING].value = static_cast<float>(m_is_running); 
-        }
-    }
+    // null until the instance used song mode
+    const SongTables *song_tables = m_song_tables.load(std::memory_order_acquire);
+    if (song_tables && !song_tables->edits.empty())
+        applySongEdits();
+
+    // the widget copied the playing song entry into m_steps, knob edits are heard from now on
+    if (song_tables && m_play_steps == &song_tables->steps[m_song_play_index] && m_song_adopted_version.load(std::memory_order_acquire) == m_song_play_version)
+        m_play_steps = &m_steps;
+
+    const bool is_song = m_is_song_mode && m_song_count > 0;
 
-    if (cv_pos > 0.0)
+    // first sample after a song switch or edit
+    if (is_song && !m_song_next_ready.load(std::memory_order_acquire))
+        prepareSongEntry();
+
+    const auto cv_pos = inputs[INP_POS].getVoltage();
+
+    if (is_song)
+    {
+        m_start_pos = m_song[m_song_pos].start;
+    } else if (cv_pos > 0.0)
     {
         m_start_pos = static_cast<int>((16.0 * cv_pos) / 5.0);
         m_start_pos = clamp(m_start_pos, 0.0, kLenSteps - 1);
@@ -141,16 +232,127 @@ void HardSeqs::process(const ProcessArgs &args)
         m_start_pos = 0;
     }
 
+    // a follower skips its own edge detection, the left HardSeqs already did it
+    const BusMessage *bus_in = busMessageFromLeft();
+
+    bool is_run_trigger = false;
+    bool is_reset = false;
+    bool is_clock_edge = false;
+    bool is_clock_high = false;
+
+    if (bus_in) {
+        is_run_trigger = bus_in->is_run_trigger;
+        is_reset = bus_in->is_reset;
+    } else {
+        m_cv_clock.update(inputs[INP_CLOCK].getVoltage());
+        m_cv_reset.update(inputs[INP_RST].getVoltage());
+
+        // cv run
+        if (inputs[INP_RUN].isConnected())
+        {
+            m_cv_run.update(inputs[INP_RUN].getVoltage());
+            is_run_trigger = m_cv_run.newTrigger();
+        }
+
+        is_reset = m_cv_reset.newTrigger();
+    }
+
+    if (is_run_trigger)
+    {
+        // sequence will turn off automatically if PARAM_REPEAT_N is set, so we ignore signal if we already running
+        bool is_enabled_and_limit_repeat = m_is_running && getParam(PARAM_REPEAT_N).value != 0.0;
+
+        if (is_enabled_and_limit_repeat == false) {
+            m_is_running = !m_is_running;
+            lights[LED_IS_RUNNING].value = static_cast<float>(m_is_running); 
+        }
+    }
+
+    // a reset that arrives just after a clock edge was meant to come first, cables between
+    // modules delay it by a sample each
+    if (m_samples_since_edge <= kResetWindows.back())
+        m_samples_since_edge++;
+
+    const bool is_late_reset = is_reset && m_samples_since_edge <= kResetWindows[m_reset_window];
+
     // cv reset
-    if (m_cv_reset.newTrigger())
+    if (is_reset)
     {
+        // pending multiplied ticks of the replayed edge survive the reset
+        const int rate_subticks = m_rate_subticks;
+
+        if (is_late_reset) {
+            m_cur_loop = m_edge_cur_loop;
+            m_is_running = m_edge_is_running;
+        }
+
         resetSteps();
+
+        if (is_late_reset)
+            m_rate_subticks = rate_subticks;
+    }
+
+    if (bus_in) {
+        is_clock_edge = bus_in->is_clock_edge;
+        is_clock_high = bus_in->is_clock_high;
+    } else {
+        const bool is_ext_edge = m_cv_clock.newTrigger();
+        is_clock_edge = is_ext_edge;
+        is_clock_high = inputs[INP_CLOCK].getVoltage() >= kCvThreshold;
+
+        if (getParam(PARAM_CLOCK_SOURCE).value != 0.0) {
+            is_clock_edge = processInternalClock(args, is_ext_edge);
+            is_clock_high = m_clock_phase < 0.5;
+        }
+    }
+
+    if (is_clock_edge) {
+        m_samples_since_edge = 0;
+        m_edge_cur_loop = m_cur_loop;
+        m_edge_is_running = m_is_running;
+    }
+
+    // the sequencer runs on ticks, OUT_CLOCK and the bus keep carrying the plain clock
+    bool is_tick_high = is_clock_high;
+    bool is_tick = processClockRate(is_clock_edge, is_tick_high);
+
+    if (is_late_reset && !is_clock_edge) {
+        // the edge before the reset is played again as the first one after it
+        const int rate = kClockRates[static_cast<int>(getParam(PARAM_CLOCK_RATE).value)];
+        if (rate < 0)
+            m_rate_edges = 1;
+
+        is_tick = true;
+    }
+
+    // chain members follow the leader's run state and playhead
+    const bool is_chain_member = bus_in && m_bus_chain && bus_in->chain_len > 0;
+    const int chain_len_right = busChainLenRight();
+    const bool is_chain = is_chain_member || chain_len_right > 0;
+    const int chain_first = is_chain_member ? bus_in->chain_offset : 0;
+
+    if (is_chain_member)
+        m_is_running = bus_in->is_running;
+
+    BusMessage bus_out;
+    bus_out.is_clock_edge = is_clock_edge;
+    bus_out.is_clock_high = is_clock_high;
+    bus_out.is_reset = is_reset;
+    bus_out.is_run_trigger = is_run_trigger;
+    bus_out.is_running = m_is_running;
+
+    if (is_chain) {
+        bus_out.chain_pos = is_chain_member ? bus_in->chain_pos : m_chain_pos;
+        bus_out.chain_len = is_chain_member ? bus_in->chain_len : m_own_len + chain_len_right;
+        bus_out.chain_offset = chain_first + m_own_len;
     }
 
+    outputs[OUT_CLOCK].setVoltage(is_clock_high ? kMaximumVoltage : 0.0);
+
     clearAllStepLights();
     clearAllStepOutputs();
 
-    if (cv_clock < kCvThreshold) {
+    if (!is_tick_high) {
         outputs[OUT_GATE].setVoltage(0.0);
 
         for (int i = OUT_STEP1; i <= OUT_STEP16; ++i) {
@@ -158,45 +360,194 @@ void HardSeqs::process(const ProcessArgs &args)
         }
     }
 
+    // fill is a held gate, sampled on the edge
+    m_cv_fill.update(inputs[INP_FILL].getVoltage());
+
     // cv clock
-    if (m_cv_clock.newTrigger() && m_is_running)
+    if (is_tick && m_is_running)
     {
-        auto &step_entry = m_steps[m_current_step];
+        m_own_len = std::min(m_start_pos + sequenceLength(is_song), kLenSteps) - m_start_pos;
+
+        updateAlgoMask(m_own_len);
+        updateMorphAmount();
+        updateTrigConditions();
+
+        // in a chain only the module owning the chain playhead plays this edge
+        bool is_active = true;
+        if (is_chain) {
+            const int chain_step = bus_out.chain_pos - chain_first;
+
+            is_active = chain_step >= 0 && chain_step < m_own_len;
+            if (is_active)
+                m_current_step = m_start_pos + chain_step;
+        }
+
+        // steps longer than one tick fire on their first tick and hold for the rest,
+        // a chain plays one step per tick in forward order
+        bool is_step_start = true;
+        if (!is_chain) {
+            updateTickMap();
+
+            // a rebuilt map restarts the step
+            if (m_tick_pos >= m_order_first_tick[m_order_len] || m_order_pos >= m_order_len
+                    || m_tick_pos < m_order_first_tick[m_order_pos] || m_tick_pos >= m_order_first_tick[m_order_pos + 1])
+                m_tick_pos = m_order_first_tick[m_order_pos];
+
+            is_step_start = m_tick_pos == m_order_first_tick[m_order_pos];
+
+            if (is_step_start && m_order_direction == DIR_CV) {
+                const int addr = static_cast<int>(inputs[INP_ADDR].getVoltage() * kLenCvStepsPerVolt);
+                m_order_pos = std::max(0, std::min(addr, m_order_len - 1));
+                m_tick_pos = m_order_first_tick[m_order_pos];
+            }
+
+            m_current_step = m_order[m_order_pos];
+        }
+
+        if (is_step_start) {
+            if (m_is_rec_pending && is_active) {
+                m_rec_pending.step = m_current_step;
+                if (!m_rec_hits.full())
+                    m_rec_hits.push(m_rec_pending);
+            }
+            m_is_rec_pending = false;
+
+            if (is_active) {
+                // the step that just ended gives the tick length, the new one may last several ticks
+                m_rec_prev_step = m_rec_last_step;
+                m_rec_last_step = m_current_step;
+                m_rec_step_period = m_rec_since_step;
+                m_rec_tick_period = m_rec_since_step / m_rec_last_ticks;
+                m_rec_last_ticks = is_chain ? 1 : m_order_first_tick[m_order_pos + 1] - m_order_first_tick[m_order_pos];
+                m_rec_since_step = 0;
+
+                if (static_cast<int>(getParam(PARAM_ALGO_MODE).value) == ALGO_MARKOV)
+                    drawMarkovGate(m_current_step);
+
+                if (m_current_step != m_playhead_step || m_cur_loop != m_playhead_loop)
+                    writePlayhead();
+            }
+
+            const auto &step_entry = (*m_play_steps)[m_current_step];
+            const auto &morph_entry = morphStep(m_current_step);
         
-        bool is_trigger = false;
-        const auto is_loop_trigger = step_entry.isTrigger();
+            bool is_trigger = false;
+            const auto is_gate_on = isStepGateOn(m_current_step);
+            const auto is_loop_trigger = isLoopTrigger(m_current_step);
+
+            bool is_prob_pass = (m_prob_mask >> m_current_step) & 1;
+            if (inputs[INP_PROB].isConnected()) {
+                const int prob_offset = static_cast<int>(std::round(stepCv(INP_PROB, m_current_step) * kProbCvPercentPerVolt));
+                is_prob_pass = m_prob_rolls[m_current_step] < std::max(0, std::min(step_entry.prob + prob_offset, 100));
+            }
+
+            const bool is_cond_pass = (trigConditionMask(m_cv_fill.isHigh()) >> m_current_step) & 1;
+
+            if (is_active && is_loop_trigger && is_prob_pass && is_cond_pass) {
+                is_trigger = is_gate_on;
+            }
 
-        if (is_loop_trigger) {
-            const auto prob_val = rand_gen_.randomPercent(step_entry.prob);
+            if (is_active)
+                m_is_prev_fired = is_trigger;
 
-            if (step_entry.prob == 100 || prob_val) {
-                is_trigger = step_entry.is_enabled;
+            outputs[OUT_STEP1 + m_current_step].setVoltage(is_trigger ? kMaximumVoltage : 0.0);
+            outputs[OUT_GATE].setVoltage(is_trigger ? kMaximumVoltage : 0.0);
+
+            if (!is_active) {
+                // mods hold while another module of the chain plays
+            } else if (is_trigger) {
+                LaneVector target;
+                laneVoltages(step_entry, morph_entry, target);
+
+                setLaneOutputs(target, step_entry.is_glide, args.sampleRate);
+            } else {
+                setLaneOutputs(LaneVector {}, false, args.sampleRate);
             }
         }
 
-        outputs[OUT_STEP1 + m_current_step].setVoltage(is_trigger ? kMaximumVoltage : 0.0);
-        outputs[OUT_GATE].setVoltage(is_trigger ? kMaximumVoltage : 0.0);
+        bool is_wrap = false;
+
+        if (is_chain) {
+            is_wrap = bus_out.chain_pos + 1 >= bus_out.chain_len;
+
+            if (!is_chain_member)
+                m_chain_pos = is_wrap ? 0 : bus_out.chain_pos + 1;
+        } else {
+            m_tick_pos++;
+
+            if (m_tick_pos >= m_order_first_tick[m_order_pos + 1]) {
+                // an addressed order keeps counting steps until the loop length is played
+                m_order_step++;
+                m_order_pos = m_order_direction == DIR_CV ? m_order_step % m_order_len : m_order_step;
+                m_tick_pos = m_order_first_tick[m_order_pos];
+            }
+
+            is_wrap = m_order_step >= m_order_len;
+            if (!is_wrap)
+                m_current_step = m_order[m_order_pos];
+        }
 
-        outputs[OUT_MOD1].setVoltage(is_trigger ? step_entry.mod1 / kModOutputDenum : 0.0);
-        outputs[OUT_MOD2].setVoltage(is_trigger ? step_entry.mod2 / kModOutputDenum : 0.0);
-        outputs[OUT_MOD3].setVoltage(is_trigger ? step_entry.mod3 / kModOutputDenum : 0.0);
+        if (is_wrap) {
+            updateElenCv();
 
-        m_current_step++;
+            // the ELEN cycle ends once every step is back at its first iteration
+            bool is_elen_end = true;
+            for (int i = 0; i < kLenSteps; ++i) {
+                incrementLoop(i, m_cv_elen[i] >= 0 ? m_cv_elen[i] : (*m_play_steps)[i].len_each_n);
+                is_elen_end = is_elen_end && m_cur_n[i] == 0;
+            }
 
-        if (m_current_step >= std::min(static_cast<int>(m_start_pos + getParam(PARAM_LEN).value), kLenSteps)) {
-            m_current_step = m_start_pos;
+            m_end_pulses[0].trigger(kEndTriggerTime);
+            if (is_elen_end)
+                m_end_pulses[1].trigger(kEndTriggerTime);
 
-            for (auto &it_step : m_steps)
-                it_step.incrementLoop();
+            const bool was_running = m_is_running;
 
             m_cur_loop++;
-            if (m_cur_loop >= getParam(PARAM_REPEAT_N).value && getParam(PARAM_REPEAT_N).value != 0.0) {
-                m_is_running = false;
-                m_cur_loop = 0;
+            m_loop_count++;
+            m_is_first_loop = false;
+            if (is_song) {
+                if (m_cur_loop >= m_song[m_song_pos].repeat)
+                    advanceSong();
+                else
+                    rollProbabilityMask();
+            } else {
+                rollProbabilityMask();
+
+                if (m_cur_loop >= getParam(PARAM_REPEAT_N).value && getParam(PARAM_REPEAT_N).value != 0.0) {
+                    m_is_running = false;
+                    m_cur_loop = 0;
+                    m_loop_count = 0;
+                    m_is_first_loop = true;
+                }
             }
+
+            if (was_running && !m_is_running)
+                m_end_pulses[2].trigger(kEndTriggerTime);
+
+            // order, length and start position of the next loop take effect here
+            beginLoop(sequenceLength(is_song));
         }
     }
 
+    processEndTriggers(args.sampleTime);
+
+    if (m_rec_since_step < kRecMaxSamples)
+        m_rec_since_step++;
+
+    if (getParam(PARAM_REC).value > 0.0 && inputs[INP_REC].isConnected()) {
+        m_cv_rec.update(inputs[INP_REC].getVoltage());
+
+        if (m_cv_rec.newTrigger() && m_is_running)
+            recordHit(args.sampleRate, is_chain);
+    }
+
+    if (m_glide_samples > 0)
+        processGlide();
+
+    // a chained module reports its steps even before the leader knows about the chain
+    publishBus(bus_out, m_bus_chain && bus_in ? m_own_len + chain_len_right : 0);
+
     // lights
     const auto repeat_n_val = getParam(ParamIds::PARAM_REPEAT_N).value;
     if (repeat_n_val == 0) {
@@ -214,160 +565,1760 @@ void HardSeqs::process(const ProcessArgs &args)
     lights[LED_IS_RUNNING].value = m_is_running ? 1.0 : 0.0;
 }
 
-void HardSeqs::stepParamChangedHandler(int step_param_id)
+bool HardSeqs::processInternalClock(const ProcessArgs &args, bool is_ext_edge)
 {
-    #ifdef HS_DEBUG
-    std::cout << "hardseqs changed param : " << step_param_id << "\n";
-    #endif
+    const int div = kClockDivisions[static_cast<int>(getParam(PARAM_CLOCK_DIV).value)];
 
-    if (step_param_id >= PARAM_STEP_ENABLED && step_param_id <= PARAM_STEP_EACH5) {
-        const auto param_val = getParam(step_param_id).value;
-        const auto new_val = param_val == 0.0 ? 1.0 : 0.0;
-        getParam(step_param_id).setValue(new_val);
+    if (m_clock_sync && inputs[INP_CLOCK].isConnected()) {
+        // incoming clock is one beat, ticks in between follow its measured period
+        if (is_ext_edge) {
+            const auto interval = m_cv_clock.triggerInterval();
+            if (interval > 0)
+                m_clock_inc = static_cast<double>(div) / interval;
+
+            // a beat tick that fired just before the edge only gets realigned
+            const bool is_beat_fired = m_clock_tick_in_beat == 0 && m_clock_phase < 0.5;
+
+            m_clock_phase = 0.0;
+            m_clock_tick_in_beat = 0;
+
+            return !is_beat_fired;
+        }
+
+        if (m_clock_inc == 0.0)
+            m_clock_inc = getParam(PARAM_BPM).value / 60.0 * div * args.sampleTime;
+    } else {
+        m_clock_inc = getParam(PARAM_BPM).value / 60.0 * div * args.sampleTime;
     }
 
-    syncParamWithLocalSteps(step_param_id);
+    m_clock_phase += m_clock_inc;
+    if (m_clock_phase < 1.0)
+        return false;
+
+    m_clock_phase -= 1.0;
+    m_clock_tick_in_beat = (m_clock_tick_in_beat + 1) % div;
+
+    return true;
 }
 
-void HardSeqs::syncParamWithLocalSteps(int step_param_id)
+bool HardSeqs::processClockRate(bool is_clock_edge, bool &is_tick_high)
 {
-    auto &cur_entry = m_steps[m_selected_step];
-
-    if (step_param_id == PARAM_STEP_ENABLED) {
-        cur_entry.is_enabled = static_cast<bool>(getParam(step_param_id).value);
-    } else if (step_param_id == PARAM_STEP_EACH1) {
-        cur_entry.each_n[0] = getParam(step_param_id).value == 1.0;
-    } else if (step_param_id == PARAM_STEP_EACH2) {
-        cur_entry.each_n[1] = getParam(step_param_id).value == 1.0;
-    } else if (step_param_id == PARAM_STEP_EACH3) {
-        cur_entry.each_n[2] = getParam(step_param_id).value == 1.0;
-    } else if (step_param_id == PARAM_STEP_EACH4) {
-        cur_entry.each_n[3] = getParam(step_param_id).value == 1.0;
-    } else if (step_param_id == PARAM_STEP_EACH5) {
-        cur_entry.each_n[4] = getParam(step_param_id).value == 1.0;
-    } else if (step_param_id == PARAM_STEP_PROB) {
-        cur_entry.prob = getParam(step_param_id).value;
-    } else if (step_param_id == PARAM_STEP_MOD1) {
-        cur_entry.mod1 = getParam(step_param_id).value;
-    } else if (step_param_id == PARAM_STEP_MOD2) {
-        cur_entry.mod2 = getParam(step_param_id).value;
-    } else if (step_param_id == PARAM_STEP_MOD3) {
-        cur_entry.mod3 = getParam(step_param_id).value;
-    } else if (step_param_id == PARAM_STEP_ELEN) {
-        cur_entry.len_each_n = static_cast<int>(getParam(step_param_id).value);
+    const int rate = kClockRates[static_cast<int>(getParam(PARAM_CLOCK_RATE).value)];
+
+    if (rate < 2) {
+        // a multiplier measures the clock again from its first edge
+        m_rate_since_edge = -1;
+        m_rate_tick_len = 0.0;
+
+        if (rate == 1 || !is_clock_edge)
+            return is_clock_edge;
+
+        const bool is_tick = m_rate_edges == 0;
+        m_rate_edges = (m_rate_edges + 1) % -rate;
+        return is_tick;
+    }
+
+    if (m_rate_since_edge >= 0)
+        m_rate_since_edge++;
+    m_rate_since_tick++;
+
+    bool is_tick = false;
+
+    if (is_clock_edge) {
+        // periods too short to split are played 1:1
+        m_rate_tick_len = m_rate_since_edge > 0 ? static_cast<float>(m_rate_since_edge) / rate : 0.0;
+        m_rate_subticks = m_rate_tick_len >= kMinRateTickSamples ? rate - 1 : 0;
+        m_rate_since_edge = 0;
+        m_rate_since_tick = 0;
+        is_tick = true;
+    } else if (m_rate_subticks > 0 && m_rate_since_tick >= m_rate_tick_len) {
+        m_rate_subticks--;
+        m_rate_since_tick = 0;
+        is_tick = true;
     }
+
+    // multiplied ticks get their own 50% gates so they don't merge with the clock's
+    if (m_rate_tick_len >= kMinRateTickSamples)
+        is_tick_high = m_rate_since_tick < m_rate_tick_len * 0.5;
+
+    return is_tick;
 }
 
-json_t* HardSeqs::dataToJson()
+void HardSeqs::updateTickMap()
 {
-    json_t* out = json_object();
+    for (int i = 0; i < kLenSteps; ++i) {
+        if (m_tick_map_durations[i] != (*m_play_steps)[i].duration) {
+            buildTickMap();
+            return;
+        }
+    }
+}
 
-    json_t* steps_array = json_array();
+void HardSeqs::buildTickMap()
+{
+    for (int i = 0; i < kLenSteps; ++i)
+        m_tick_map_durations[i] = static_cast<uint8_t>((*m_play_steps)[i].duration);
+
+    int tick = 0;
+    for (int p = 0; p < m_order_len; ++p) {
+        m_order_first_tick[p] = static_cast<uint16_t>(tick);
+        tick += m_tick_map_durations[m_order[p]];
+    }
 
-    for (const auto &it : m_steps) {
-        json_t* json_entry = json_object();
+    m_order_first_tick[m_order_len] = static_cast<uint16_t>(tick);
+}
 
-        json_object_set_new(json_entry, "is_enabled", json_integer(static_cast<int>(it.is_enabled)));
-        json_object_set_new(json_entry, "prob", json_integer(it.prob));
-        json_object_set_new(json_entry, "mod1", json_real(it.mod1));
-        json_object_set_new(json_entry, "mod2", json_real(it.mod2));
-        json_object_set_new(json_entry, "mod3", json_real(it.mod3));
-        json_object_set_new(json_entry, "len_each_n", json_integer(it.len_each_n));
+int HardSeqs::orderPosAt(int tick) const
+{
+    // durations are at least one tick, so first ticks are strictly increasing
+    const auto first = m_order_first_tick.begin();
+    return static_cast<int>(std::upper_bound(first, first + m_order_len + 1, tick) - first) - 1;
+}
 
-        json_object_set_new(json_entry, "each_step1_enabled", json_integer(static_cast<int>(it.each_n[0])));
-        json_object_set_new(json_entry, "each_step2_enabled", json_integer(static_cast<int>(it.each_n[1])));
-        json_object_set_new(json_entry, "each_step3_enabled", json_integer(static_cast<int>(it.each_n[2])));
-        json_object_set_new(json_entry, "each_step4_enabled", json_integer(static_cast<int>(it.each_n[3])));
-        json_object_set_new(json_entry, "each_step5_enabled", json_integer(static_cast<int>(it.each_n[4])));
+void HardSeqs::buildStepOrder(int len)
+{
+    len = std::max(1, std::min(m_start_pos + len, kLenSteps) - m_start_pos);
+
+    m_order_direction = static_cast<int>(getParam(PARAM_DIRECTION).value);
+    m_order_len = len;
+
+    for (int i = 0; i < len; ++i)
+        m_order[i] = static_cast<uint8_t>(i);
+
+    if (m_order_direction == DIR_REVERSE) {
+        std::reverse(m_order.begin(), m_order.begin() + len);
+    } else if (m_order_direction == DIR_PING_PONG) {
+        // the end steps play once per cycle
+        for (int i = len - 2; i > 0; --i)
+            m_order[m_order_len++] = static_cast<uint8_t>(i);
+    } else if (m_order_direction == DIR_ODD_EVEN) {
+        // 1st, 3rd, ... then 2nd, 4th, ...
+        int n = 0;
+        for (int i = 0; i < len; i += 2)
+            m_order[n++] = static_cast<uint8_t>(i);
+        for (int i = 1; i < len; i += 2)
+            m_order[n++] = static_cast<uint8_t>(i);
+    } else if (m_order_direction == DIR_SHUFFLE) {
+        rand_gen_.shuffle(m_order.begin(), m_order.begin() + len);
+    } else if (m_order_direction == DIR_RANDOM_WALK) {
+        // one step forward or back per entry, wrapping inside the loop, continued across loops
+        uint32_t bits = rand_gen_.randomU32();
+        int pos = m_walk_pos % len;
+
+        for (int i = 0; i < len; ++i) {
+            m_order[i] = static_cast<uint8_t>(pos);
+            pos = (pos + ((bits >> (i % 32)) & 1 ? 1 : len - 1)) % len;
+        }
 
-        json_array_append_new(steps_array, json_entry);
+        m_walk_pos = pos;
     }
 
-    json_object_set_new(out, "steps", steps_array);
-    json_object_set_new(out, "is_running", json_integer(static_cast<int>(m_is_running)));
+    for (int p = 0; p < m_order_len; ++p)
+        m_order[p] += m_start_pos;
 
-    return out;
+    buildTickMap();
 }
 
-void HardSeqs::dataFromJson(json_t* from)
+void HardSeqs::beginLoop(int len)
 {
-    json_t* steps_array = json_object_get(from, "steps");
-    json_t* is_running = json_object_get(from, "is_running");
+    buildStepOrder(len);
 
-    std::size_t index;
-    json_t* json_entry;
+    m_order_pos = 0;
+    m_order_step = 0;
+    m_tick_pos = 0;
+    m_current_step = m_order[0];
+}
 
-    json_array_foreach(steps_array, index, json_entry) {
-        json_t* val_is_enabled = json_object_get(json_entry, "is_enabled");
-        json_t* val_prob = json_object_get(json_entry, "prob");
-        json_t* val_mod1 = json_object_get(json_entry, "mod1");
-        json_t* val_mod2 = json_object_get(json_entry, "mod2");
-        json_t* val_mod3 = json_object_get(json_entry, "mod3");
-        json_t* val_len_each_n = json_object_get(json_entry, "len_each_n");
-
-        json_t* val_each_step1_enabled = json_object_get(json_entry, "each_step1_enabled");
-        json_t* val_each_step2_enabled = json_object_get(json_entry, "each_step2_enabled");
-        json_t* val_each_step3_enabled = json_object_get(json_entry, "each_step3_enabled");
-        json_t* val_each_step4_enabled = json_object_get(json_entry, "each_step4_enabled");
-        json_t* val_each_step5_enabled = json_object_get(json_entry, "each_step5_enabled");
-
-        m_steps[index].is_enabled = static_cast<bool>(json_integer_value(val_is_enabled));
-        m_steps[index].prob = static_cast<int>(json_integer_value(val_prob));
-        m_steps[index].mod1 = static_cast<float>(json_real_value(val_mod1));
-        m_steps[index].mod2 = static_cast<float>(json_real_value(val_mod2));
-        m_steps[index].mod3 = static_cast<float>(json_real_value(val_mod3));
-        m_steps[index].len_each_n = static_cast<int>(json_integer_value(val_len_each_n));
-
-        m_steps[index].each_n[0] = static_cast<bool>(json_integer_value(val_each_step1_enabled));
-        m_steps[index].each_n[1] = static_cast<bool>(json_integer_value(val_each_step2_enabled));
-        m_steps[index].each_n[2] = static_cast<bool>(json_integer_value(val_each_step3_enabled));
-        m_steps[index].each_n[3] = static_cast<bool>(json_integer_value(val_each_step4_enabled));
-        m_steps[index].each_n[4] = static_cast<bool>(json_integer_value(val_each_step5_enabled));
+static uint8_t packCycle(const HardSeqs::StepEntry &it)
+{
+    return static_cast<uint8_t>((it.cycle_a - 1) | ((it.cycle_b - 1) << kPackedCycleShift));
+}
+
+void HardSeqs::updateTrigConditions()
+{
+    // the cycle steps that play change once per loop
+    bool is_changed = m_cycle_compiled_loop != m_loop_count;
+    for (int i = 0; i < kLenSteps; ++i) {
+        const auto &it = (*m_play_steps)[i];
+        is_changed = is_changed || m_cond_compiled[i] != it.condition || m_cycle_compiled[i] != packCycle(it);
     }
 
-    m_is_running = static_cast<bool>(json_integer_value(is_running));
+    if (!is_changed)
+        return;
 
-    getParam(PARAM_STEP1).setValue(1.0);
-    setSelectedStep(0);
+    m_cond_masks.fill(0);
+    m_cycle_pass_mask = 0;
+    for (int i = 0; i < kLenSteps; ++i) {
+        const auto &it = (*m_play_steps)[i];
+
+        m_cond_compiled[i] = static_cast<uint8_t>(it.condition);
+        m_cycle_compiled[i] = packCycle(it);
+        m_cond_masks[m_cond_compiled[i]] |= 1u << i;
+
+        if (m_loop_count % it.cycle_b == static_cast<uint32_t>(it.cycle_a - 1))
+            m_cycle_pass_mask |= 1u << i;
+    }
+    m_cycle_compiled_loop = m_loop_count;
 }
 
-void HardSeqs::clearAllStepLights()
+uint16_t HardSeqs::trigConditionMask(bool is_fill) const
+{
+    const uint16_t blocked = m_cond_masks[is_fill ? TRIG_NOT_FILL : TRIG_FILL]
+        | m_cond_masks[m_is_first_loop ? TRIG_NOT_FIRST : TRIG_FIRST]
+        | m_cond_masks[m_is_prev_fired ? TRIG_NOT_PREV : TRIG_PREV]
+        | (m_cond_masks[TRIG_CYCLE] & ~m_cycle_pass_mask);
+
+    return static_cast<uint16_t>(~blocked);
+}
+
+void HardSeqs::recordHit(float sample_rate, bool is_chain)
+{
+    if (m_rec_last_step < 0 || m_rec_step_period <= 0)
+        return;
+
+    RecHit hit;
+    if (m_rec_lane >= 0 && inputs[INP_REC_CV].isConnected()) {
+        const auto quantity = getParamQuantity(laneParam(m_rec_lane));
+        const float value = inputs[INP_REC_CV].getVoltage() * kModOutputDenum;
+
+        hit.lane = m_rec_lane;
+        hit.value = std::max(quantity->minValue, std::min(value, quantity->maxValue));
+    }
+
+    // where the hit was played, relative to the last step start
+    const float offset = m_rec_since_step - kRecLatenciesMs[m_rec_latency] * 0.001f * sample_rate;
+
+    if (offset >= m_rec_tick_period * m_rec_last_ticks * 0.5f) {
+        hit.step = recordNextStep(is_chain);
+        if (hit.step < 0) {
+            m_rec_pending = hit;
+            m_is_rec_pending = true;
+            return;
+        }
+    } else if (offset < -m_rec_step_period * 0.5f) {
+        hit.step = m_rec_prev_step;
+    } else {
+        hit.step = m_rec_last_step;
+    }
+
+    if (hit.step >= 0 && !m_rec_hits.full())
+        m_rec_hits.push(hit);
+}
+
+int HardSeqs::recordNextStep(bool is_chain) const
+{
+    // chain and address CV pick the next step when it starts
+    if (is_chain || m_order_direction == DIR_CV)
+        return -1;
+
+    // the order position already moved on if the playing step has no ticks left
+    if (m_tick_pos == m_order_first_tick[m_order_pos])
+        return m_order[m_order_pos];
+
+    // the next loop's order is built once this one ends
+    return m_order_pos + 1 < m_order_len ? m_order[m_order_pos + 1] : -1;
+}
+
+static uint16_t probMask(const HardSeqs::StepTable &steps, const std::array<uint8_t, kLenSteps> &rolls)
 {
+    uint16_t mask = 0;
+
     for (int i = 0; i < kLenSteps; ++i) {
-        lights[i + LED_STEP1].value = m_steps[i].is_enabled ? kStepEnabled : 0.0;
+        if (rolls[i] < steps[i].prob)
+            mask |= 1u << i;
     }
 
-    lights[LED_STEP1 + m_current_step].value = kStepPlaying;
+    return mask;
 }
 
-void HardSeqs::clearAllStepOutputs()
+void HardSeqs::rollProbabilityMask()
 {
-    for (int i = OUT_STEP1; i <= OUT_STEP16; ++i)
-        outputs[i].setVoltage(0.0);
+    if (m_is_prob_frozen)
+        return;
+
+    rand_gen_.randomPercentRolls(m_prob_rolls);
+    m_prob_mask = probMask(*m_play_steps, m_prob_rolls);
 }
 
-void HardSeqs::resetSteps()
+void HardSeqs::rerollProbabilityMask()
 {
-    m_current_step = m_start_pos;
+    // a new variation from the context menu, frozen rolls stay frozen afterwards
+    m_is_reroll_pending.store(false, std::memory_order_relaxed);
 
-    for (auto &it : m_steps)
-        it.cur_n = 0;
+    const bool is_frozen = m_is_prob_frozen;
+    m_is_prob_frozen = false;
+    rollProbabilityMask();
+    m_is_prob_frozen = is_frozen;
 }
 
-void HardSeqs::generateRandomGateSequence(int temp)
+float HardSeqs::stepCv(int input_id, int step)
 {
-    for (int i = 0; i < kLenSteps; ++i)
-        m_steps[i].is_enabled = rand_gen_.randomPercent(temp);
+    auto &input = inputs[input_id];
+    const int channels = input.getChannels();
+
+    if (channels <= 1)
+        return input.getVoltage();
+
+    return step < channels ? input.getVoltage(step) : 0.0;
+}
+
+int HardSeqs::sequenceLength(bool is_song)
+{
+    if (is_song)
+        return m_song[m_song_pos].len;
+
+    if (inputs[INP_LEN].isConnected()) {
+        const int len = static_cast<int>(std::round(inputs[INP_LEN].getVoltage() * kLenCvStepsPerVolt));
+        return std::max(1, std::min(len, kLenSteps));
+    }
+
+    return static_cast<int>(getParam(PARAM_LEN).value);
+}
+
+int HardSeqs::valueLane(int param_id)
+{
+    if (param_id >= PARAM_STEP_MOD1 && param_id <= PARAM_STEP_MOD3)
+        return param_id - PARAM_STEP_MOD1;
+    if (param_id >= PARAM_STEP_ACCENT && param_id <= PARAM_STEP_LANE8)
+        return kAccentLane + param_id - PARAM_STEP_ACCENT;
+
+    return -1;
+}
+
+int HardSeqs::laneParam(int lane)
+{
+    return lane < kAccentLane ? PARAM_STEP_MOD1 + lane : PARAM_STEP_ACCENT + lane - kAccentLane;
+}
+
+void HardSeqs::laneVoltages(const StepEntry &entry, const StepEntry &morph_entry, LaneVector &volts)
+{
+    const simd::float_4 amount = m_morph_amount;
+
+    for (int i = 0; i < kLaneVectors; ++i) {
+        const auto from = simd::float_4::load(&entry.values[4 * i]);
+        const auto to = simd::float_4::load(&morph_entry.values[4 * i]);
+
+        volts[i] = (from + (to - from) * amount) / kModOutputDenum;
+    }
+
+    // mod1..3 also take their offset inputs and the quantizer
+    for (int lane = 0; lane < kModOutputs; ++lane) {
+        float lane_volts = volts[0][lane] + stepCv(INP_MOD1 + lane, m_current_step);
+
+        if (m_quant_scale[lane] >= 0)
+            lane_volts = ScaleTables::quantize(lane_volts, m_quant_scale[lane], m_quant_root[lane]);
+
+        volts[0][lane] = lane_volts;
+    }
+
+    for (auto &it : volts)
+        it = simd::clamp(it, -kMaximumVoltage, kMaximumVoltage);
+}
+
+void HardSeqs::setLaneOutputs(const LaneVector &target, bool is_glide, float sample_rate)
+{
+    const float glide_time = getParam(PARAM_GLIDE_TIME).value;
+
+    if (is_glide && glide_time > 0.0) {
+        m_glide_samples = std::max(1, static_cast<int>(glide_time * sample_rate));
+        m_glide_target = target;
+
+        for (int i = 0; i < kLaneVectors; ++i)
+            m_glide_inc[i] = (target[i] - m_glide_value[i]) / static_cast<float>(m_glide_samples);
+        return;
+    }
+
+    m_glide_samples = 0;
+    m_glide_value = target;
+
+    writeLaneOutputs(target);
+}
+
+void HardSeqs::writeLaneOutputs(const LaneVector &volts)
+{
+    for (int i = 0; i < kModOutputs; ++i)
+        outputs[OUT_MOD1 + i].setVoltage(volts[0][i]);
+
+    outputs[OUT_LANES].setChannels(m_lane_count);
+    for (int i = 0; i < kLaneVectors; ++i)
+        outputs[OUT_LANES].setVoltageSimd(volts[i], 4 * i);
+}
+
+void HardSeqs::processGlide()
+{
+    for (int i = 0; i < kLaneVectors; ++i)
+        m_glide_value[i] += m_glide_inc[i];
+
+    if (--m_glide_samples == 0)
+        m_glide_value = m_glide_target;
+
+    writeLaneOutputs(m_glide_value);
+}
+
+void HardSeqs::processEndTriggers(float sample_time)
+{
+    for (int i = 0; i < static_cast<int>(m_end_pulses.size()); ++i) {
+        const bool is_high = m_end_pulses[i].process(sample_time);
+        if (is_high == m_end_high[i])
+            continue;
+
+        m_end_high[i] = is_high;
+        outputs[OUT_EOL + i].setVoltage(is_high ? kMaximumVoltage : 0.0);
+    }
+}
+
+void HardSeqs::writePlayhead()
+{
+    // a patch or preset load may have reset the channel count, both are written every time
+    outputs[OUT_PLAYHEAD].setChannels(2);
+
+    m_playhead_step = m_current_step;
+    m_playhead_loop = m_cur_loop;
+
+    outputs[OUT_PLAYHEAD].setVoltage(m_playhead_step * kPlayheadStepVolts, 0);
+    outputs[OUT_PLAYHEAD].setVoltage(std::min(m_playhead_loop * kPlayheadLoopVolts, kMaximumVoltage), 1);
+}
+
+const BusMessage* HardSeqs::busMessageFromLeft()
+{
+    if (!(m_bus_follow || m_bus_chain) || !leftExpander.module || leftExpander.module->model != modelHardSeqs)
+        return nullptr;
+
+    return static_cast<const BusMessage*>(leftExpander.consumerMessage);
 }
 
-void HardSeqs::StepEntry::incrementLoop()
+int HardSeqs::busChainLenRight()
 {
-    cur_n += 1;
-    if (cur_n >= len_each_n)
-        cur_n = 0;
+    if (!rightExpander.module || rightExpander.module->model != modelHardSeqs)
+        return 0;
+
+    return static_cast<const BusReply*>(rightExpander.consumerMessage)->chain_len_right;
 }
 
-bool HardSeqs::StepEntry::isTrigger() const
+void HardSeqs::publishBus(const BusMessage &message, int chain_len_right)
 {
-    return each_n[cur_n];
+    Module *right = rightExpander.module;
+    if (right && right->model == modelHardSeqs) {
+        *static_cast<BusMessage*>(right->leftExpander.producerMessage) = message;
+        right->leftExpander.requestMessageFlip();
+    }
+
+    Module *left = leftExpander.module;
+    if (left && left->model == modelHardSeqs) {
+        static_cast<BusReply*>(left->rightExpander.producerMessage)->chain_len_right = chain_len_right;
+        left->rightExpander.requestMessageFlip();
+    }
+}
+
+void HardSeqs::updateElenCv()
+{
+    if (!inputs[INP_ELEN].isConnected()) {
+        m_cv_elen.fill(-1);
+        return;
+    }
+
+    for (int i = 0; i < kLenSteps; ++i) {
+        const int elen = static_cast<int>(std::round(stepCv(INP_ELEN, i) * kElenCvPerVolt));
+        m_cv_elen[i] = static_cast<int8_t>(std::max(0, std::min(elen, kLenEach)));
+    }
+}
+
+static_assert(kPackedLanes == kValueLanes, "packed steps carry every value lane");
+
+static bool isEmptyPattern(const PackedPattern &pattern)
+{
+    static const PackedPattern kEmptyPattern = HardSeqs::packStepArray(HardSeqs::StepTable());
+    return std::memcmp(&pattern, &kEmptyPattern, sizeof(PackedPattern)) == 0;
+}
+
+PackedPattern HardSeqs::packStepArray(const StepTable &steps)
+{
+    PackedPattern pattern;
+
+    for (int i = 0; i < kLenSteps; ++i) {
+        const auto &it = steps[i];
+        auto &packed = pattern.steps[i];
+
+        packed.flags = it.is_enabled ? kPackedGate : 0;
+        for (int n = 0; n < kLenEach; ++n)
+            packed.flags |= static_cast<uint8_t>(it.each_n[n]) << (kPackedEachShift + n);
+        if (it.is_glide)
+            packed.flags |= kPackedGlide;
+
+        packed.len_each_n = static_cast<uint8_t>(it.len_each_n | (it.condition << kPackedCondShift));
+        packed.prob = static_cast<uint8_t>(it.prob);
+        packed.extra_ticks = static_cast<uint8_t>(it.duration - 1);
+        packed.cycle = packCycle(it);
+        std::fill(std::begin(packed.reserved), std::end(packed.reserved), 0);
+        for (int lane = 0; lane < kValueLanes; ++lane)
+            packed.values[lane] = it.values[lane];
+    }
+
+    return pattern;
+}
+
+void HardSeqs::unpackStepArray(const PackedPattern &pattern, StepTable &steps)
+{
+    for (int i = 0; i < kLenSteps; ++i) {
+        const auto &packed = pattern.steps[i];
+        auto &it = steps[i];
+
+        it.is_enabled = packed.flags & kPackedGate;
+        for (int n = 0; n < kLenEach; ++n)
+            it.each_n[n] = (packed.flags >> (kPackedEachShift + n)) & 1;
+        it.is_glide = packed.flags & kPackedGlide;
+
+        it.len_each_n = std::min(packed.len_each_n & kPackedElenMask, kLenEach);
+        it.condition = std::min(packed.len_each_n >> kPackedCondShift, TRIG_COUNT - 1);
+        it.prob = std::min(static_cast<int>(packed.prob), 100);
+        it.duration = std::min(packed.extra_ticks + 1, kMaxStepTicks);
+        it.cycle_b = std::min((packed.cycle >> kPackedCycleShift) + 1, kMaxCycleLen);
+        it.cycle_a = std::min((packed.cycle & kPackedCycleMask) + 1, kMaxCycleLen);
+        for (int lane = 0; lane < kValueLanes; ++lane)
+            it.values[lane] = packed.values[lane];
+    }
+}
+
+HardSeqs::SongTables& HardSeqs::allocSongTables()
+{
+    // UI thread, the tables stay allocated until the module is deleted
+    SongTables *song_tables = m_song_tables.load(std::memory_order_relaxed);
+    if (!song_tables) {
+        song_tables = new SongTables();
+        song_tables->bank.fill(packStepArray(StepTable()));
+        song_tables->bank_copy = song_tables->bank;
+        m_song_tables.store(song_tables, std::memory_order_release);
+    }
+
+    return *song_tables;
+}
+
+HardSeqs::SongTables& HardSeqs::songTables() const
+{
+    // only called once the song was used, see m_song_tables
+    return *m_song_tables.load(std::memory_order_relaxed);
+}
+
+void HardSeqs::startSong()
+{
+    m_cur_loop = 0;
+    m_song_pass = 0;
+    m_song_pos = 0;
+    m_song_next_ready.store(false, std::memory_order_release);
+
+    if (m_song_count == 0) {
+        publishSongSnapshot();
+        return;
+    }
+
+    loadSongEntry(0);
+    m_cur_n.fill(0);
+
+    m_start_pos = m_song[0].start;
+    m_current_step = m_start_pos;
+    rollProbabilityMask();
+}
+
+void HardSeqs::prepareSongEntry()
+{
+    m_song_next_pos = (m_song_pos + 1) % m_song_count;
+    const auto &entry = m_song[m_song_next_pos];
+
+    // the table that is not playing
+    auto &song_tables = songTables();
+    auto &next_steps = song_tables.steps[m_song_play_index ^ 1];
+    unpackStepArray(song_tables.bank[entry.slot], next_steps);
+
+    rand_gen_.randomPercentRolls(m_song_next_prob_rolls);
+    m_song_next_prob_mask = probMask(next_steps, m_song_next_prob_rolls);
+    m_song_next_ready.store(true, std::memory_order_release);
+}
+
+void HardSeqs::advanceSong()
+{
+    // the list was edited since the last sample
+    if (!m_song_next_ready.load(std::memory_order_acquire))
+        prepareSongEntry();
+
+    // REPEAT counts whole passes through the song
+    if (m_song_next_pos == 0) {
+        m_song_pass++;
+
+        const auto repeat_n_val = getParam(PARAM_REPEAT_N).value;
+        if (repeat_n_val != 0.0 && m_song_pass >= repeat_n_val) {
+            m_is_running = false;
+            m_song_pass = 0;
+        }
+    }
+
+    m_song_pos = m_song_next_pos;
+    playSongSteps();
+    m_cur_n.fill(0);
+
+    if (!m_is_prob_frozen) {
+        m_prob_mask = m_song_next_prob_mask;
+        m_prob_rolls = m_song_next_prob_rolls;
+    }
+
+    m_start_pos = m_song[m_song_pos].start;
+    m_current_step = m_start_pos;
+    m_cur_loop = 0;
+
+    m_song_next_ready.store(false, std::memory_order_release);
+}
+
+void HardSeqs::loadSongEntry(int pos)
+{
+    auto &song_tables = songTables();
+    unpackStepArray(song_tables.bank[m_song[pos].slot], song_tables.steps[m_song_play_index ^ 1]);
+    playSongSteps();
+
+    // the prepared entry was in the table that plays now
+    markSongChanged();
+}
+
+void HardSeqs::playSongSteps()
+{
+    // the table that is not playing holds the entry to start
+    m_song_play_index ^= 1;
+    m_play_steps = &songTables().steps[m_song_play_index];
+    m_song_play_version++;
+
+    publishSongSnapshot();
+}
+
+void HardSeqs::stopSongSteps()
+{
+    const SongTables *song_tables = m_song_tables.load(std::memory_order_relaxed);
+    if (song_tables && (m_play_steps == &song_tables->steps[0] || m_play_steps == &song_tables->steps[1]))
+        m_play_steps = &m_steps;
+}
+
+void HardSeqs::publishSongSnapshot()
+{
+    auto &snapshot = m_song_snapshot.back();
+
+    snapshot.entries = m_song;
+    snapshot.count = m_song_count;
+    snapshot.pos = m_song_pos;
+    snapshot.is_song_mode = m_is_song_mode;
+    snapshot.play_version = m_song_play_version;
+    snapshot.play_slot = m_song[m_song_pos].slot;
+
+    m_song_snapshot.publish();
+}
+
+bool HardSeqs::adoptSongSteps()
+{
+    // UI thread, a song entry started playing: its steps become the ones edits start from
+    m_song_snapshot.update();
+
+    const auto &snapshot = m_song_snapshot.front();
+    if (snapshot.play_version == m_song_adopted_version.load(std::memory_order_relaxed))
+        return false;
+
+    unpackSteps(songTables().bank_copy[snapshot.play_slot]);
+    m_song_adopted_version.store(snapshot.play_version, std::memory_order_release);
+    return true;
+}
+
+void HardSeqs::storeSongSlot(int slot)
+{
+    SongEdit edit;
+    edit.command = SONG_STORE;
+    edit.index = slot;
+    edit.pattern = packSteps();
+
+    queueSongEdit(edit);
+}
+
+void HardSeqs::loadSongSlot(int slot)
+{
+    unpackSteps(allocSongTables().bank_copy[slot]);
+    publishLinkedSteps();
+}
+
+void HardSeqs::addSongEntry()
+{
+    SongEdit edit;
+    edit.command = SONG_ADD;
+    edit.entry.len = static_cast<uint8_t>(getParam(PARAM_LEN).value);
+    edit.entry.start = m_start_pos;
+
+    queueSongEdit(edit);
+}
+
+void HardSeqs::setSongEntry(int index, const SongEntry &entry)
+{
+    SongEdit edit;
+    edit.command = SONG_SET;
+    edit.index = index;
+    edit.entry = entry;
+
+    queueSongEdit(edit);
+}
+
+void HardSeqs::removeSongEntry(int index)
+{
+    SongEdit edit;
+    edit.command = SONG_REMOVE;
+    edit.index = index;
+
+    queueSongEdit(edit);
+}
+
+void HardSeqs::setSongMode(bool is_enabled)
+{
+    SongEdit edit;
+    edit.command = SONG_MODE;
+    edit.index = static_cast<int>(is_enabled);
+
+    queueSongEdit(edit);
+}
+
+void HardSeqs::queueSongEdit(const SongEdit &edit)
+{
+    auto &song_tables = allocSongTables();
+    if (edit.command == SONG_STORE)
+        song_tables.bank_copy[edit.index] = edit.pattern;
+
+    m_song_edits_unsent.push_back(edit);
+    flushSongEdits();
+}
+
+void HardSeqs::flushSongEdits()
+{
+    // UI thread, keeps the order of edits when the audio thread falls behind
+    if (m_song_edits_unsent.empty())
+        return;
+
+    auto &edits = songTables().edits;
+    while (!m_song_edits_unsent.empty() && !edits.full()) {
+        edits.push(m_song_edits_unsent.front());
+        m_song_edits_unsent.pop_front();
+    }
+}
+
+void HardSeqs::applySongEdits()
+{
+    auto &song_tables = songTables();
+    while (!song_tables.edits.empty()) {
+        const SongEdit edit = song_tables.edits.shift();
+
+        if (edit.command == SONG_ADD) {
+            if (m_song_count >= kSongEntries)
+                continue;
+
+            m_song[m_song_count] = edit.entry;
+            m_song[m_song_count].slot = m_song_count > 0 ? m_song[m_song_count - 1].slot : 0;
+            m_song_count++;
+        } else if (edit.command == SONG_SET) {
+            if (edit.index < 0 || edit.index >= m_song_count)
+                continue;
+
+            m_song[edit.index] = edit.entry;
+        } else if (edit.command == SONG_REMOVE) {
+            if (edit.index < 0 || edit.index >= m_song_count)
+                continue;
+
+            for (int i = edit.index; i < m_song_count - 1; ++i)
+                m_song[i] = m_song[i + 1];
+
+            m_song_count--;
+
+            if (m_song_pos > edit.index)
+                m_song_pos--;
+            if (m_song_pos >= m_song_count)
+                m_song_pos = 0;
+        } else if (edit.command == SONG_STORE) {
+            song_tables.bank[edit.index] = edit.pattern;
+        } else if (edit.command == SONG_MODE) {
+            m_is_song_mode = edit.index != 0;
+            if (m_is_song_mode)
+                startSong();
+        }
+
+        markSongChanged();
+    }
+
+    // the last entry playing was removed or song mode ended, m_steps holds what played last
+    if (!m_is_song_mode || m_song_count == 0)
+        stopSongSteps();
+
+    publishSongSnapshot();
+}
+
+void HardSeqs::markSongChanged()
+{
+    m_song_next_ready.store(false, std::memory_order_release);
+}
+
+void HardSeqs::stepParamChangedHandler(int step_param_id)
+{
+    #ifdef HS_DEBUG
+    std::cout << "hardseqs changed param : " << step_param_id << "\n";
+    #endif
+
+    if ((step_param_id >= PARAM_STEP_ENABLED && step_param_id <= PARAM_STEP_EACH5) || step_param_id == PARAM_STEP_GLIDE) {
+        const auto param_val = getParam(step_param_id).value;
+        const auto new_val = param_val == 0.0 ? 1.0 : 0.0;
+        getParam(step_param_id).setValue(new_val);
+    }
+
+    syncParamWithLocalSteps(step_param_id);
+    publishLinkedSteps();
+}
+
+void HardSeqs::syncParamWithLocalSteps(int step_param_id)
+{
+    m_steps[m_selected_step].setField(step_param_id, getParam(step_param_id).value);
+}
+
+static json_t* stepToJson(const HardSeqs::StepEntry &it)
+{
+    json_t* json_entry = json_object();
+
+    json_object_set_new(json_entry, "is_enabled", json_integer(static_cast<int>(it.is_enabled)));
+    json_object_set_new(json_entry, "prob", json_integer(it.prob));
+    json_object_set_new(json_entry, "len_each_n", json_integer(it.len_each_n));
+    json_object_set_new(json_entry, "glide", json_integer(static_cast<int>(it.is_glide)));
+    json_object_set_new(json_entry, "duration", json_integer(it.duration));
+    json_object_set_new(json_entry, "condition", json_integer(it.condition));
+    json_object_set_new(json_entry, "cycle_a", json_integer(it.cycle_a));
+    json_object_set_new(json_entry, "cycle_b", json_integer(it.cycle_b));
+
+    // lanes up to the last non-zero one
+    int lane_count = kValueLanes;
+    while (lane_count > 0 && it.values[lane_count - 1] == 0.0)
+        lane_count--;
+
+    json_t* values_array = json_array();
+    for (int i = 0; i < lane_count; ++i)
+        json_array_append_new(values_array, json_real(it.values[i]));
+
+    json_object_set_new(json_entry, "values", values_array);
+    // older builds only read the first three lanes, from their own keys
+    json_object_set_new(json_entry, "mod1", json_real(it.values[0]));
+    json_object_set_new(json_entry, "mod2", json_real(it.values[1]));
+    json_object_set_new(json_entry, "mod3", json_real(it.values[2]));
+
+    json_object_set_new(json_entry, "each_step1_enabled", json_integer(static_cast<int>(it.each_n[0])));
+    json_object_set_new(json_entry, "each_step2_enabled", json_integer(static_cast<int>(it.each_n[1])));
+    json_object_set_new(json_entry, "each_step3_enabled", json_integer(static_cast<int>(it.each_n[2])));
+    json_object_set_new(json_entry, "each_step4_enabled", json_integer(static_cast<int>(it.each_n[3])));
+    json_object_set_new(json_entry, "each_step5_enabled", json_integer(static_cast<int>(it.each_n[4])));
+
+    return json_entry;
+}
+
+static void stepFromJson(json_t* json_entry, HardSeqs::StepEntry &it)
+{
+    json_t* val_is_enabled = json_object_get(json_entry, "is_enabled");
+    json_t* val_prob = json_object_get(json_entry, "prob");
+    json_t* val_len_each_n = json_object_get(json_entry, "len_each_n");
+
+    json_t* val_each_step1_enabled = json_object_get(json_entry, "each_step1_enabled");
+    json_t* val_each_step2_enabled = json_object_get(json_entry, "each_step2_enabled");
+    json_t* val_each_step3_enabled = json_object_get(json_entry, "each_step3_enabled");
+    json_t* val_each_step4_enabled = json_object_get(json_entry, "each_step4_enabled");
+    json_t* val_each_step5_enabled = json_object_get(json_entry, "each_step5_enabled");
+
+    it.is_enabled = static_cast<bool>(json_integer_value(val_is_enabled));
+    it.prob = static_cast<int>(json_integer_value(val_prob));
+    it.values.fill(0.0);
+
+    json_t* values_array = json_object_get(json_entry, "values");
+    if (values_array) {
+        size_t index;
+        json_t* json_value;
+        json_array_foreach(values_array, index, json_value) {
+            if (index < kValueLanes)
+                it.values[index] = static_cast<float>(json_real_value(json_value));
+        }
+    } else {
+        // patches from before the value lanes
+        it.values[0] = static_cast<float>(json_real_value(json_object_get(json_entry, "mod1")));
+        it.values[1] = static_cast<float>(json_real_value(json_object_get(json_entry, "mod2")));
+        it.values[2] = static_cast<float>(json_real_value(json_object_get(json_entry, "mod3")));
+    }
+    it.len_each_n = static_cast<int>(json_integer_value(val_len_each_n));
+    it.is_glide = static_cast<bool>(json_integer_value(json_object_get(json_entry, "glide")));
+
+    json_t* val_duration = json_object_get(json_entry, "duration");
+    it.duration = val_duration ? std::max(1, std::min(static_cast<int>(json_integer_value(val_duration)), kMaxStepTicks)) : 1;
+    it.condition = std::max(0, std::min(static_cast<int>(json_integer_value(json_object_get(json_entry, "condition"))), HardSeqs::TRIG_COUNT - 1));
+
+    json_t* val_cycle_a = json_object_get(json_entry, "cycle_a");
+    json_t* val_cycle_b = json_object_get(json_entry, "cycle_b");
+    it.cycle_b = val_cycle_b ? std::max(1, std::min(static_cast<int>(json_integer_value(val_cycle_b)), kMaxCycleLen)) : 1;
+    it.cycle_a = val_cycle_a ? std::max(1, std::min(static_cast<int>(json_integer_value(val_cycle_a)), kMaxCycleLen)) : 1;
+
+    it.each_n[0] = static_cast<bool>(json_integer_value(val_each_step1_enabled));
+    it.each_n[1] = static_cast<bool>(json_integer_value(val_each_step2_enabled));
+    it.each_n[2] = static_cast<bool>(json_integer_value(val_each_step3_enabled));
+    it.each_n[3] = static_cast<bool>(json_integer_value(val_each_step4_enabled));
+    it.each_n[4] = static_cast<bool>(json_integer_value(val_each_step5_enabled));
+}
+
+json_t* HardSeqs::dataToJson()
+{
+    syncLinkedSteps();
+
+    json_t* out = json_object();
+
+    json_t* steps_array = json_array();
+    for (const auto &it : m_steps)
+        json_array_append_new(steps_array, stepToJson(it));
+
+    json_t* morph_steps_array = json_array();
+    if (const StepTable *morph_steps = m_morph_steps.load(std::memory_order_relaxed)) {
+        for (const auto &it : *morph_steps)
+            json_array_append_new(morph_steps_array, stepToJson(it));
+    }
+
+    json_t* morph_thresholds_array = json_array();
+    for (const auto &it : m_morph_thresholds)
+        json_array_append_new(morph_thresholds_array, json_real(it));
+
+    json_object_set_new(out, "steps", steps_array);
+    json_object_set_new(out, "morph_steps", morph_steps_array);
+    json_object_set_new(out, "morph_thresholds", morph_thresholds_array);
+    json_object_set_new(out, "is_running", json_integer(static_cast<int>(m_is_running)));
+    json_object_set_new(out, "link_group", json_integer(m_link_group.load()));
+    json_object_set_new(out, "clock_sync", json_integer(static_cast<int>(m_clock_sync)));
+    json_object_set_new(out, "reset_window", json_integer(m_reset_window));
+    json_object_set_new(out, "rec_lane", json_integer(m_rec_lane));
+    json_object_set_new(out, "rec_latency", json_integer(m_rec_latency));
+    json_object_set_new(out, "bus_follow", json_integer(static_cast<int>(m_bus_follow)));
+    json_object_set_new(out, "bus_chain", json_integer(static_cast<int>(m_bus_chain)));
+    json_object_set_new(out, "remote", json_integer(static_cast<int>(m_is_remote)));
+    json_object_set_new(out, "prob_frozen", json_integer(static_cast<int>(m_is_prob_frozen)));
+    json_object_set_new(out, "prob_mask", json_integer(m_prob_mask));
+
+    json_t* prob_rolls_array = json_array();
+    for (const auto &it : m_prob_rolls)
+        json_array_append_new(prob_rolls_array, json_integer(it));
+
+    json_object_set_new(out, "prob_rolls", prob_rolls_array);
+
+    json_t* quantizer_array = json_array();
+    for (int i = 0; i < kModOutputs; ++i) {
+        json_t* json_quant = json_object();
+
+        json_object_set_new(json_quant, "scale", json_integer(m_quant_scale[i]));
+        json_object_set_new(json_quant, "root", json_integer(m_quant_root[i]));
+
+        json_array_append_new(quantizer_array, json_quant);
+    }
+
+    json_object_set_new(out, "quantizer", quantizer_array);
+    json_object_set_new(out, "lane_count", json_integer(m_lane_count));
+
+    // the UI side of the song, the list and bank themselves belong to the audio thread
+    m_song_snapshot.update();
+    const auto &song = m_song_snapshot.front();
+
+    json_t* song_bank_array = json_array();
+    if (const SongTables *song_tables = m_song_tables.load(std::memory_order_relaxed)) {
+        for (const auto &it_pattern : song_tables->bank_copy) {
+            std::array<StepEntry, kLenSteps> slot_steps;
+            unpackStepArray(it_pattern, slot_steps);
+
+            json_t* slot_array = json_array();
+            for (const auto &it : slot_steps)
+                json_array_append_new(slot_array, stepToJson(it));
+
+            json_array_append_new(song_bank_array, slot_array);
+        }
+    }
+
+    json_t* song_array = json_array();
+    for (int i = 0; i < song.count; ++i) {
+        const auto &it = song.entries[i];
+        json_t* json_song_entry = json_object();
+
+        json_object_set_new(json_song_entry, "slot", json_integer(it.slot));
+        json_object_set_new(json_song_entry, "repeat", json_integer(it.repeat));
+        json_object_set_new(json_song_entry, "len", json_integer(it.len));
+        json_object_set_new(json_song_entry, "start", json_integer(it.start));
+
+        json_array_append_new(song_array, json_song_entry);
+    }
+
+    json_object_set_new(out, "song_mode", json_integer(static_cast<int>(song.is_song_mode)));
+    json_object_set_new(out, "song_bank", song_bank_array);
+    json_object_set_new(out, "song", song_array);
+
+    if (PatternLibrary::shared().isOpen())
+        json_object_set_new(out, "library_path", json_string(PatternLibrary::shared().path().c_str()));
+
+    json_object_set_new(out, "playhead", playheadToJson());
+
+    return out;
+}
+
+json_t* HardSeqs::playheadToJson() const
+{
+    json_t* out = json_object();
+
+    json_object_set_new(out, "step", json_integer(m_current_step));
+    json_object_set_new(out, "tick", json_integer(m_tick_pos));
+    json_object_set_new(out, "loop", json_integer(m_cur_loop));
+    json_object_set_new(out, "chain_pos", json_integer(m_chain_pos));
+    json_object_set_new(out, "song_pos", json_integer(m_song_pos));
+    json_object_set_new(out, "song_pass", json_integer(m_song_pass));
+    json_object_set_new(out, "rate_edges", json_integer(m_rate_edges));
+    json_object_set_new(out, "first", json_integer(static_cast<int>(m_is_first_loop)));
+    json_object_set_new(out, "loop_count", json_integer(m_loop_count));
+    json_object_set_new(out, "prev_fired", json_integer(static_cast<int>(m_is_prev_fired)));
+
+    json_t* cur_n_array = json_array();
+    for (const auto cur_n : m_cur_n)
+        json_array_append_new(cur_n_array, json_integer(cur_n));
+
+    json_object_set_new(out, "cur_n", cur_n_array);
+
+    json_t* order_array = json_array();
+    for (int p = 0; p < m_order_len; ++p)
+        json_array_append_new(order_array, json_integer(m_order[p]));
+
+    json_object_set_new(out, "order", order_array);
+    json_object_set_new(out, "order_step", json_integer(m_order_step));
+
+    return out;
+}
+
+void HardSeqs::playheadFromJson(json_t* playhead)
+{
+    const bool is_song = m_is_song_mode && m_song_count > 0;
+
+    if (!playhead) {
+        beginLoop(sequenceLength(is_song));
+        return;
+    }
+
+    if (is_song) {
+        const int song_pos = static_cast<int>(json_integer_value(json_object_get(playhead, "song_pos")));
+
+        m_song_pos = std::max(0, std::min(song_pos, m_song_count - 1));
+        m_song_pass = static_cast<uint8_t>(json_integer_value(json_object_get(playhead, "song_pass")));
+        m_start_pos = m_song[m_song_pos].start;
+
+        loadSongEntry(m_song_pos);
+    }
+
+    size_t index;
+    json_t* json_entry;
+    json_array_foreach(json_object_get(playhead, "cur_n"), index, json_entry) {
+        if (index < kLenSteps)
+            m_cur_n[index] = static_cast<uint8_t>(std::max(0, std::min(static_cast<int>(json_integer_value(json_entry)), kLenEach - 1)));
+    }
+
+    // the saved order keeps a random loop going, without it the loop order is built again
+    json_t* order_array = json_object_get(playhead, "order");
+    const int order_len = static_cast<int>(json_array_size(order_array));
+
+    if (order_len > 0 && order_len <= kMaxOrderLen) {
+        m_order_direction = static_cast<int>(getParam(PARAM_DIRECTION).value);
+        m_order_len = order_len;
+
+        json_array_foreach(order_array, index, json_entry)
+            m_order[index] = static_cast<uint8_t>(std::max(0, std::min(static_cast<int>(json_integer_value(json_entry)), kLenSteps - 1)));
+
+        buildTickMap();
+    } else {
+        beginLoop(sequenceLength(is_song));
+    }
+
+    const int tick = static_cast<int>(json_integer_value(json_object_get(playhead, "tick")));
+    const int order_step = static_cast<int>(json_integer_value(json_object_get(playhead, "order_step")));
+
+    m_tick_pos = std::max(0, std::min(tick, m_order_first_tick[m_order_len] - 1));
+    m_order_pos = orderPosAt(m_tick_pos);
+    m_order_step = m_order_direction == DIR_CV ? std::max(0, std::min(order_step, m_order_len - 1)) : m_order_pos;
+    m_current_step = m_order[m_order_pos];
+    m_cur_loop = static_cast<uint8_t>(json_integer_value(json_object_get(playhead, "loop")));
+    json_t* val_first = json_object_get(playhead, "first");
+    m_is_first_loop = val_first ? json_integer_value(val_first) != 0 : m_cur_loop == 0;
+    json_t* val_loop_count = json_object_get(playhead, "loop_count");
+    m_loop_count = val_loop_count ? static_cast<uint32_t>(json_integer_value(val_loop_count)) : m_cur_loop;
+    m_is_prev_fired = json_integer_value(json_object_get(playhead, "prev_fired")) != 0;
+    m_chain_pos = static_cast<int>(json_integer_value(json_object_get(playhead, "chain_pos")));
+    m_rate_edges = static_cast<int>(json_integer_value(json_object_get(playhead, "rate_edges")));
+}
+
+void HardSeqs::fastForward(uint64_t ticks)
+{
+    // from a reset, ticks = sequencer ticks played since then. Each pass is a fixed number of
+    // ticks, so the position, loop and ELEN phases follow from ticks / pass and ticks % pass.
+    resetSteps();
+
+    if (m_is_song_mode && m_song_count > 0) {
+        fastForwardSong(ticks);
+        return;
+    }
+
+    // resetSteps() built the order of the first loop, a random order is taken to repeat
+    const int len = std::min(m_start_pos + sequenceLength(false), kLenSteps) - m_start_pos;
+    const uint64_t pass_ticks = m_order_first_tick[m_order_len];
+
+    // nothing to play, stay at the reset position
+    if (pass_ticks == 0)
+        return;
+
+    uint64_t passes = ticks / pass_ticks;
+    int tick = static_cast<int>(ticks % pass_ticks);
+
+    const auto repeat_n = static_cast<uint64_t>(getParam(PARAM_REPEAT_N).value);
+    const bool is_stopped = repeat_n != 0 && passes >= repeat_n;
+    if (is_stopped) {
+        passes = repeat_n;
+        tick = 0;
+        m_is_running = false;
+    }
+
+    setLoopPosition(passes);
+    m_cur_loop = is_stopped ? 0 : static_cast<uint8_t>(passes);
+    m_loop_count = is_stopped ? 0 : static_cast<uint32_t>(passes);
+    m_own_len = len;
+
+    m_tick_pos = tick;
+    m_order_pos = orderPosAt(m_tick_pos);
+    m_order_step = m_order_pos;
+    m_current_step = m_order[m_order_pos];
+}
+
+static uint64_t passTicks(const PackedPattern &pattern, int start, int len, int direction)
+{
+    const int end = std::max(start + 1, std::min(start + len, kLenSteps));
+    uint64_t ticks = 0;
+
+    for (int i = start; i < end; ++i) {
+        ticks += pattern.steps[i].extra_ticks + 1;
+
+        // ping-pong plays all but the end steps twice
+        if (direction == HardSeqs::DIR_PING_PONG && i > start && i < end - 1)
+            ticks += pattern.steps[i].extra_ticks + 1;
+    }
+
+    return ticks;
+}
+
+void HardSeqs::fastForwardSong(uint64_t ticks)
+{
+    std::array<uint64_t, kSongEntries> entry_ticks;
+    uint64_t song_ticks = 0;
+    uint64_t song_loops = 0;
+
+    for (int i = 0; i < m_song_count; ++i) {
+        const auto &entry = m_song[i];
+
+        entry_ticks[i] = passTicks(songTables().bank[entry.slot], entry.start, entry.len, static_cast<int>(getParam(PARAM_DIRECTION).value)) * entry.repeat;
+        song_ticks += entry_ticks[i];
+        song_loops += entry.repeat;
+    }
+
+    // only zero length entries, stay at the song start
+    if (song_ticks == 0)
+        return;
+
+    const uint64_t song_passes = ticks / song_ticks;
+    uint64_t tick = ticks % song_ticks;
+
+    // REPEAT counts whole songs, startSong() already put a finished song back to its start
+    const auto repeat_n = static_cast<uint64_t>(getParam(PARAM_REPEAT_N).value);
+    if (repeat_n != 0 && song_passes >= repeat_n) {
+        m_is_running = false;
+        return;
+    }
+
+    uint64_t loops = song_passes * song_loops;
+    int pos = 0;
+    while (tick >= entry_ticks[pos]) {
+        tick -= entry_ticks[pos];
+        loops += m_song[pos].repeat;
+        pos++;
+    }
+
+    const auto &entry = m_song[pos];
+    const uint64_t pass_ticks = entry_ticks[pos] / entry.repeat;
+
+    m_song_pos = pos;
+    m_song_pass = static_cast<uint8_t>(song_passes);
+    m_start_pos = entry.start;
+
+    loadSongEntry(pos);
+    beginLoop(entry.len);
+
+    // ELEN cycles are taken to start with the entry
+    setLoopPosition(tick / pass_ticks);
+    m_cur_loop = static_cast<uint8_t>(tick / pass_ticks);
+    m_loop_count = static_cast<uint32_t>(loops + tick / pass_ticks);
+    m_own_len = std::min(entry.start + entry.len, kLenSteps) - entry.start;
+
+    // a random walk may not add up to the forward pass length
+    m_tick_pos = static_cast<int>(tick % pass_ticks % m_order_first_tick[m_order_len]);
+    m_order_pos = orderPosAt(m_tick_pos);
+    m_order_step = m_order_pos;
+    m_current_step = m_order[m_order_pos];
+}
+
+void HardSeqs::setLoopPosition(uint64_t passes)
+{
+    // incrementLoop() once per pass from cur_n = 0
+    updateElenCv();
+
+    for (int i = 0; i < kLenSteps; ++i) {
+        const int elen = m_cv_elen[i] >= 0 ? m_cv_elen[i] : (*m_play_steps)[i].len_each_n;
+        m_cur_n[i] = elen > 0 ? static_cast<uint8_t>(passes % elen) : 0;
+    }
+
+    m_is_first_loop = passes == 0;
+}
+
+void HardSeqs::dataFromJson(json_t* from)
+{
+    json_t* steps_array = json_object_get(from, "steps");
+    json_t* morph_steps_array = json_object_get(from, "morph_steps");
+    json_t* morph_thresholds_array = json_object_get(from, "morph_thresholds");
+    json_t* is_running = json_object_get(from, "is_running");
+
+    std::size_t index;
+    json_t* json_entry;
+
+    json_array_foreach(steps_array, index, json_entry) {
+        if (index < kLenSteps)
+            stepFromJson(json_entry, m_steps[index]);
+    }
+
+    // a target of empty steps plays like no target at all
+    if (json_array_size(morph_steps_array) > 0) {
+        StepTable morph_steps;
+        json_array_foreach(morph_steps_array, index, json_entry) {
+            if (index < kLenSteps)
+                stepFromJson(json_entry, morph_steps[index]);
+        }
+
+        if (m_morph_steps.load(std::memory_order_relaxed) || !isEmptyPattern(packStepArray(morph_steps)))
+            allocMorphSteps() = morph_steps;
+    }
+
+    json_array_foreach(morph_thresholds_array, index, json_entry) {
+        if (index < kLenSteps)
+            m_morph_thresholds[index] = static_cast<float>(json_real_value(json_entry));
+    }
+
+    m_is_running = static_cast<bool>(json_integer_value(is_running));
+
+    json_t* clock_sync = json_object_get(from, "clock_sync");
+    m_clock_sync = static_cast<bool>(json_integer_value(clock_sync));
+
+    // patches from before the window keep their exact reset timing
+    json_t* reset_window = json_object_get(from, "reset_window");
+    m_reset_window = reset_window ? std::max(0, std::min(static_cast<int>(json_integer_value(reset_window)), static_cast<int>(kResetWindows.size()) - 1)) : 0;
+
+    json_t* rec_lane = json_object_get(from, "rec_lane");
+    m_rec_lane = rec_lane ? std::max(-1, std::min(static_cast<int>(json_integer_value(rec_lane)), kValueLanes - 1)) : -1;
+    m_rec_latency = std::max(0, std::min(static_cast<int>(json_integer_value(json_object_get(from, "rec_latency"))), static_cast<int>(kRecLatenciesMs.size()) - 1));
+
+    m_bus_follow = static_cast<bool>(json_integer_value(json_object_get(from, "bus_follow")));
+    m_bus_chain = static_cast<bool>(json_integer_value(json_object_get(from, "bus_chain")));
+
+    const bool is_remote = static_cast<bool>(json_integer_value(json_object_get(from, "remote")));
+    if (is_remote != m_is_remote)
+        setRemoteControl(is_remote);
+
+    json_t* prob_frozen = json_object_get(from, "prob_frozen");
+    json_t* prob_mask = json_object_get(from, "prob_mask");
+    m_is_prob_frozen = static_cast<bool>(json_integer_value(prob_frozen));
+    if (prob_mask)
+        m_prob_mask = static_cast<uint16_t>(json_integer_value(prob_mask));
+
+    json_t* prob_rolls_array = json_object_get(from, "prob_rolls");
+    json_array_foreach(prob_rolls_array, index, json_entry) {
+        if (index < kLenSteps)
+            m_prob_rolls[index] = static_cast<uint8_t>(json_integer_value(json_entry));
+    }
+
+    json_t* lane_count = json_object_get(from, "lane_count");
+    if (lane_count)
+        m_lane_count = std::max(1, std::min(static_cast<int>(json_integer_value(lane_count)), kValueLanes));
+
+    json_t* quantizer_array = json_object_get(from, "quantizer");
+    json_array_foreach(quantizer_array, index, json_entry) {
+        if (index >= kModOutputs)
+            break;
+
+        const int scale = static_cast<int>(json_integer_value(json_object_get(json_entry, "scale")));
+        const int root = static_cast<int>(json_integer_value(json_object_get(json_entry, "root")));
+
+        m_quant_scale[index] = static_cast<int8_t>(std::max(-1, std::min(scale, ScaleTables::kScaleCount - 1)));
+        m_quant_root[index] = static_cast<int8_t>(std::max(0, std::min(root, ScaleTables::kSemitones - 1)));
+    }
+
+    json_t* song_bank_array = json_object_get(from, "song_bank");
+    json_array_foreach(song_bank_array, index, json_entry) {
+        if (index >= kSongSlots)
+            break;
+
+        std::array<StepEntry, kLenSteps> slot_steps;
+        std::size_t step_index;
+        json_t* json_step;
+
+        json_array_foreach(json_entry, step_index, json_step) {
+            if (step_index < kLenSteps)
+                stepFromJson(json_step, slot_steps[step_index]);
+        }
+
+        // empty slots need no song storage
+        const PackedPattern pattern = packStepArray(slot_steps);
+        if (m_song_tables.load(std::memory_order_relaxed) || !isEmptyPattern(pattern))
+            allocSongTables().bank[index] = pattern;
+    }
+
+    json_t* song_array = json_object_get(from, "song");
+    m_song_count = 0;
+    json_array_foreach(song_array, index, json_entry) {
+        if (m_song_count >= kSongEntries)
+            break;
+
+        const int slot = static_cast<int>(json_integer_value(json_object_get(json_entry, "slot")));
+        const int repeat = static_cast<int>(json_integer_value(json_object_get(json_entry, "repeat")));
+        const int len = static_cast<int>(json_integer_value(json_object_get(json_entry, "len")));
+        const int start = static_cast<int>(json_integer_value(json_object_get(json_entry, "start")));
+
+        auto &it = m_song[m_song_count++];
+        it.slot = static_cast<uint8_t>(std::max(0, std::min(slot, kSongSlots - 1)));
+        it.repeat = static_cast<uint8_t>(std::max(1, std::min(repeat, kSongMaxRepeat)));
+        it.len = static_cast<uint8_t>(std::max(1, std::min(len, kLenSteps)));
+        it.start = static_cast<uint8_t>(std::max(0, std::min(start, kLenSteps - 1)));
+    }
+
+    if (m_song_count > 0)
+        allocSongTables();
+    if (SongTables *song_tables = m_song_tables.load(std::memory_order_relaxed))
+        song_tables->bank_copy = song_tables->bank;
+
+    json_t* song_mode = json_object_get(from, "song_mode");
+    m_is_song_mode = static_cast<bool>(json_integer_value(song_mode));
+    if (m_is_song_mode) {
+        startSong();
+    } else {
+        stopSongSteps();
+        publishSongSnapshot();
+    }
+
+    json_t* link_group = json_object_get(from, "link_group");
+    setLinkGroup(link_group ? static_cast<int>(json_integer_value(link_group)) : -1, true);
+
+    json_t* library_path = json_object_get(from, "library_path");
+    if (library_path && !PatternLibrary::shared().isOpen())
+        PatternLibrary::shared().open(json_string_value(library_path));
+
+    playheadFromJson(json_object_get(from, "playhead"));
+
+    getParam(PARAM_STEP1).setValue(1.0);
+    setSelectedStep(0);
+}
+
+void HardSeqs::clearAllStepLights()
+{
+    const auto gate_mask = displayedGateMask();
+
+    for (int i = 0; i < kLenSteps; ++i) {
+        lights[i + LED_STEP1].value = ((gate_mask >> i) & 1) ? kStepEnabled : 0.0;
+    }
+
+    lights[LED_STEP1 + m_current_step].value = kStepPlaying;
+}
+
+void HardSeqs::clearAllStepOutputs()
+{
+    for (int i = OUT_STEP1; i <= OUT_STEP16; ++i)
+        outputs[i].setVoltage(0.0);
+}
+
+void HardSeqs::resetSteps()
+{
+    if (m_is_song_mode)
+        startSong();
+
+    m_walk_pos = 0;
+    beginLoop(sequenceLength(m_is_song_mode && m_song_count > 0));
+
+    // internal clock restarts with a beat tick on the next sample
+    m_clock_phase = 1.0;
+    m_clock_tick_in_beat = -1;
+    m_chain_pos = 0;
+
+    // divided clocks restart on the next edge, pending multiplied ticks are dropped
+    m_rate_edges = 0;
+    m_rate_subticks = 0;
+
+    rollProbabilityMask();
+    m_cur_n.fill(0);
+
+    m_loop_count = 0;
+    m_is_first_loop = true;
+    m_is_prev_fired = false;
+}
+
+void HardSeqs::generateRandomGateSequence(int temp)
+{
+    for (int i = 0; i < kLenSteps; ++i)
+        m_steps[i].is_enabled = rand_gen_.randomPercent(temp);
+
+    publishLinkedSteps();
+}
+
+void HardSeqs::generateConstrainedGateSequence()
+{
+    PatternConstraints constraints = m_gen_constraints;
+    constraints.len = static_cast<int>(getParam(PARAM_LEN).value);
+    constraints.current_mask = gateMask();
+    constraints.seed = rand_gen_.randomU32();
+
+    auto *left = dynamic_cast<HardSeqs*>(leftExpander.module);
+    constraints.avoid_mask = (m_gen_avoid_left && left) ? left->gateMask() : 0;
+
+    if (constraints.len == 0)
+        return;
+
+    // a search still running is dropped, only the latest one gets applied
+    m_gen_job = PatternGenerator::start(constraints);
+}
+
+void HardSeqs::applyGateMask(uint16_t mask)
+{
+    #ifdef HS_DEBUG
+    std::cout << "constrained gate mask : " << mask << "\n";
+    #endif
+
+    for (int i = 0; i < kLenSteps; ++i)
+        m_steps[i].is_enabled = (mask >> i) & 1;
+
+    setSelectedStep(m_selected_step);
+    publishLinkedSteps();
+}
+
+PackedPattern HardSeqs::packSteps() const
+{
+    return packStepArray(m_steps);
+}
+
+void HardSeqs::unpackSteps(const PackedPattern &pattern)
+{
+    unpackStepArray(pattern, m_steps);
+    setSelectedStep(m_selected_step);
+}
+
+void HardSeqs::setLinkGroup(int group, bool is_publish)
+{
+    auto &links = PatternLinks::shared();
+
+    // the instance keeps the group's latest steps, its audio thread switches to them on its own
+    const int old_group = m_link_group.exchange(-1);
+    if (old_group >= 0) {
+        if (!is_publish)
+            links.snapshot(old_group, m_steps, m_link_copy_version);
+        links.detach(old_group, &m_link_version);
+    }
+
+    if (group < 0 || group >= kLinkGroups)
+        return;
+
+    // First member seeds the group with its own steps, others adopt the group's. A loaded
+    // patch or preset publishes its steps to the group instead.
+    if (!links.attach(group, &m_link_version) || is_publish)
+        m_link_copy_version = links.publish(group, packSteps());
+
+    m_link_group.store(group);
+}
+
+void HardSeqs::publishLinkedSteps()
+{
+    const int group = m_link_group.load();
+
+    if (group >= 0)
+        m_link_copy_version = PatternLinks::shared().publish(group, packSteps());
+}
+
+bool HardSeqs::syncLinkedSteps()
+{
+    // UI thread, takes the copy that edits start from once the group published something newer
+    const int group = m_link_group.load();
+
+    return group >= 0 && PatternLinks::shared().snapshot(group, m_steps, m_link_copy_version);
+}
+
+void HardSeqs::applyLinkedSteps(int group)
+{
+    auto &links = PatternLinks::shared();
+
+    const auto *shared = links.current(group);
+    if (!shared || shared == m_link_pattern)
+        return;
+
+    // Acknowledging 0 holds every version of the group while switching. The group is read again
+    // after that, a version that was already replaced may be freed before it is acknowledged.
+    m_link_version.store(0);
+    shared = links.current(group);
+
+    m_link_pattern = shared;
+    m_play_steps = &shared->steps;
+    m_link_version.store(shared->version);
+}
+
+void HardSeqs::releaseLinkedSteps()
+{
+    // left the group, setLinkGroup() copied its latest steps into m_steps
+    m_play_steps = &m_steps;
+    m_link_pattern = nullptr;
+    m_link_version.store(kLinkReleased);
+}
+
+void HardSeqs::onAdd(const AddEvent &e)
+{
+    // the module id is final only once the module is in the engine
+    if (m_is_remote)
+        ControlSocket::shared().attach(id, m_control_inbox.get());
+}
+
+void HardSeqs::onRemove(const RemoveEvent &e)
+{
+    if (m_is_remote)
+        ControlSocket::shared().detach(m_control_inbox.get());
+}
+
+void HardSeqs::setRemoteControl(bool is_enabled)
+{
+    m_is_remote = is_enabled;
+
+    if (is_enabled) {
+        if (!m_control_inbox)
+            m_control_inbox.reset(new ControlInbox());
+        if (id >= 0)
+            ControlSocket::shared().attach(id, m_control_inbox.get());
+    } else if (m_control_inbox) {
+        // the socket thread is done with the inbox once it is detached
+        ControlSocket::shared().detach(m_control_inbox.get());
+        m_control_inbox.reset();
+    }
+}
+
+void HardSeqs::applyControlMessages()
+{
+    // UI thread, the widget turns the step edits into one undo entry
+    bool is_steps_changed = false;
+
+    while (!m_control_inbox->empty()) {
+        const auto message = m_control_inbox->shift();
+
+        if (message.command == CONTROL_SET_STEPS) {
+            unpackSteps(message.pattern);
+            is_steps_changed = true;
+        } else if (message.command == CONTROL_SET_BANK_SLOT) {
+            SongEdit edit;
+            edit.command = SONG_STORE;
+            edit.index = message.index;
+            edit.pattern = message.pattern;
+
+            queueSongEdit(edit);
+        } else if (message.command == CONTROL_SET_STEP) {
+            auto pattern = packSteps();
+            pattern.steps[message.index] = message.pattern.steps[0];
+            unpackSteps(pattern);
+            is_steps_changed = true;
+        } else if (message.command == CONTROL_FAST_FORWARD) {
+            m_fast_forward_ticks.store(message.ticks, std::memory_order_relaxed);
+            m_is_fast_forward_pending.store(true, std::memory_order_release);
+        }
+    }
+
+    if (is_steps_changed)
+        publishLinkedSteps();
+}
+
+uint16_t HardSeqs::gateMask() const
+{
+    uint16_t mask = 0;
+    for (int i = 0; i < kLenSteps; ++i)
+        mask |= static_cast<uint16_t>(m_steps[i].is_enabled) << i;
+
+    return mask;
+}
+
+void HardSeqs::updateAlgoMask(int len)
+{
+    const auto mode = static_cast<int>(getParam(PARAM_ALGO_MODE).value);
+    if (mode == ALGO_MANUAL || mode == ALGO_MARKOV)
+        return;
+
+    const int fill = algoControl(PARAM_ALGO_FILL, INP_ALGO_FILL, kLenSteps);
+    const int shift = algoControl(PARAM_ALGO_SHIFT, INP_ALGO_SHIFT, kLenSteps - 1);
+
+    const uint16_t base = mode == ALGO_EUCLID ? PatternTables::euclid(fill, len) : PatternTables::densityRamp(fill, len);
+    m_algo_mask = static_cast<uint16_t>(PatternTables::rotateMask(base, shift, len) << m_start_pos);
+}
+
+int HardSeqs::algoControl(int param_id, int input_id, int max_val)
+{
+    const float val = getParam(param_id).value + inputs[input_id].getVoltage() * kAlgoCvStepsPerVolt;
+    return std::max(0, std::min(static_cast<int>(val + 0.5), max_val));
+}
+
+void HardSeqs::drawMarkovGate(int step)
+{
+    // one draw per step start, the gate is read back from m_algo_mask however often it is checked
+    const int fill = algoControl(PARAM_ALGO_FILL, INP_ALGO_FILL, kLenSteps);
+    const int bias = algoControl(PARAM_ALGO_SHIFT, INP_ALGO_SHIFT, PatternTables::kMarkovBias - 1);
+
+    m_algo_last_gate = rand_gen_.randomPercent(PatternTables::markovPercent(fill, bias, m_algo_last_gate));
+
+    if (m_algo_last_gate)
+        m_algo_mask |= 1u << step;
+    else
+        m_algo_mask &= ~(1u << step);
+}
+
+bool HardSeqs::isStepGateOn(int step) const
+{
+    if (static_cast<int>(params[PARAM_ALGO_MODE].value) == ALGO_MANUAL) {
+        const auto &entry = m_morph_amount >= m_morph_thresholds[step] ? morphStep(step) : (*m_play_steps)[step];
+        return entry.is_enabled;
+    }
+
+    return (m_algo_mask >> step) & 1;
+}
+
+uint16_t HardSeqs::displayedGateMask() const
+{
+    if (static_cast<int>(params[PARAM_ALGO_MODE].value) != ALGO_MANUAL)
+        return m_algo_mask;
+
+    // thresholds are above 0, no morph plays the live steps only
+    uint16_t mask = 0;
+    for (int i = 0; i < kLenSteps; ++i) {
+        const auto &entry = m_morph_amount >= m_morph_thresholds[i] ? morphStep(i) : (*m_play_steps)[i];
+        mask |= static_cast<uint16_t>(entry.is_enabled) << i;
+    }
+
+    return mask;
+}
+
+void HardSeqs::updateMorphAmount()
+{
+    const float amount = getParam(PARAM_MORPH).value + inputs[INP_MORPH].getVoltage() / kMaximumVoltage;
+    m_morph_amount = std::max(0.0f, std::min(amount, 1.0f));
+}
+
+HardSeqs::StepTable& HardSeqs::allocMorphSteps()
+{
+    // UI thread, the target stays allocated until the module is deleted
+    StepTable *morph_steps = m_morph_steps.load(std::memory_order_relaxed);
+    if (!morph_steps) {
+        morph_steps = new StepTable();
+        m_morph_steps.store(morph_steps, std::memory_order_release);
+    }
+
+    return *morph_steps;
+}
+
+const HardSeqs::StepEntry& HardSeqs::morphStep(int step) const
+{
+    static const StepEntry kEmptyStep;
+
+    const StepTable *morph_steps = m_morph_steps.load(std::memory_order_acquire);
+    return morph_steps ? (*morph_steps)[step] : kEmptyStep;
+}
+
+void HardSeqs::storeMorphTarget()
+{
+    allocMorphSteps() = m_steps;
+}
+
+void HardSeqs::swapMorphTarget()
+{
+    std::swap(m_steps, allocMorphSteps());
+
+    setSelectedStep(m_selected_step);
+    publishLinkedSteps();
+}
+
+void HardSeqs::shuffleMorphThresholds()
+{
+    // Thresholds are spread evenly inside (0, 1), so 0% is always slot A and 100% always slot B
+    std::array<int, kLenSteps> order;
+    for (int i = 0; i < kLenSteps; ++i)
+        order[i] = i;
+
+    rand_gen_.shuffle(order.begin(), order.end());
+
+    for (int i = 0; i < kLenSteps; ++i)
+        m_morph_thresholds[order[i]] = (i + 0.5f) / kLenSteps;
+}
+
+void HardSeqs::incrementLoop(int step, int len)
+{
+    m_cur_n[step] += 1;
+    if (m_cur_n[step] >= len)
+        m_cur_n[step] = 0;
+}
+
+bool HardSeqs::isLoopTrigger(int step) const
+{
+    // a shorter ELEN from a new pattern starts over at its first iteration
+    const auto &entry = (*m_play_steps)[step];
+    return entry.each_n[m_cur_n[step] < entry.len_each_n ? m_cur_n[step] : 0];
+}
+
+float HardSeqs::StepEntry::field(int param_id) const
+{
+    if (param_id == PARAM_STEP_ENABLED)
+        return static_cast<float>(is_enabled);
+    if (param_id >= PARAM_STEP_EACH1 && param_id <= PARAM_STEP_EACH5)
+        return static_cast<float>(each_n[param_id - PARAM_STEP_EACH1]);
+    if (param_id == PARAM_STEP_PROB)
+        return static_cast<float>(prob);
+    if (valueLane(param_id) >= 0)
+        return values[valueLane(param_id)];
+    if (param_id == PARAM_STEP_ELEN)
+        return static_cast<float>(len_each_n);
+    if (param_id == PARAM_STEP_GLIDE)
+        return static_cast<float>(is_glide);
+    if (param_id == PARAM_STEP_DURATION)
+        return static_cast<float>(duration);
+    if (param_id == PARAM_STEP_COND)
+        return static_cast<float>(condition);
+    if (param_id == PARAM_STEP_CYCLE_A)
+        return static_cast<float>(cycle_a);
+    if (param_id == PARAM_STEP_CYCLE_B)
+        return static_cast<float>(cycle_b);
+
+    return 0.0;
+}
+
+void HardSeqs::StepEntry::setField(int param_id, float value)
+{
+    if (param_id == PARAM_STEP_ENABLED) {
+        is_enabled = static_cast<bool>(value);
+    } else if (param_id >= PARAM_STEP_EACH1 && param_id <= PARAM_STEP_EACH5) {
+        each_n[param_id - PARAM_STEP_EACH1] = value == 1.0;
+    } else if (param_id == PARAM_STEP_PROB) {
+        prob = static_cast<int>(value);
+    } else if (valueLane(param_id) >= 0) {
+        values[valueLane(param_id)] = value;
+    } else if (param_id == PARAM_STEP_ELEN) {
+        len_each_n = static_cast<int>(value);
+    } else if (param_id == PARAM_STEP_GLIDE) {
+        is_glide = static_cast<bool>(value);
+    } else if (param_id == PARAM_STEP_DURATION) {
+        duration = std::max(1, std::min(static_cast<int>(value), kMaxStepTicks));
+    } else if (param_id == PARAM_STEP_COND) {
+        condition = std::max(0, std::min(static_cast<int>(value), TRIG_COUNT - 1));
+    } else if (param_id == PARAM_STEP_CYCLE_A) {
+        cycle_a = std::max(1, std::min(static_cast<int>(value), kMaxCycleLen));
+    } else if (param_id == PARAM_STEP_CYCLE_B) {
+        cycle_b = std::max(1, std::min(static_cast<int>(value), kMaxCycleLen));
+    }
 }
\ No newline at end of file
@@ -1,8 +1,20 @@
+#pragma once
+
 #include <cstdint>
 #include <array>
 #include <memory>
+#include <atomic>
+#include <deque>
 
 #include "RandomGenerator.hpp"
+#include "PatternGenerator.hpp"
+#include "PatternTables.hpp"
+#include "ScaleTables.hpp"
+#include "PackedPattern.hpp"
+#include "ExpanderBus.hpp"
+#include "ControlSocket.hpp"
+#include "Profiler.hpp"
+#include "TripleBuffer.hpp"
 
 #include "CV.hpp"
 #include "Plugin.hpp"
@@ -10,6 +22,11 @@
 
 constexpr const int kLenSteps = 16;
 constexpr const int kLenEach = 5;
+constexpr const int kModOutputs = 3;
+// Per-step value lanes: mod1..3, accent, lanes 5..8. Lanes beyond kModOutputs only reach OUT_LANES.
+constexpr const int kValueLanes = 8;
+constexpr const int kAccentLane = 3;
+constexpr const int kLaneVectors = kValueLanes / 4;
 constexpr const float kMaximumVoltage = 10.0;
 constexpr const float kCvThreshold = 0.5;
 
@@ -25,6 +42,50 @@ constexpr const float kStepDefaultMod1 = 0.0;
 constexpr const float kStepDefaultMod2 = 0.0;
 constexpr const float kStepDefaultMod3 = 0.0;
 constexpr const float kStepDefaultElen = kLenEach;
+constexpr const int kMaxStepTicks = 16;
+// Longest step order of one loop, ping-pong over 16 steps plays 30
+constexpr const int kMaxOrderLen = 2 * kLenSteps;
+// Longest loop cycle of the A:B trig condition
+constexpr const int kMaxCycleLen = 8;
+
+// Internal clock ticks per beat, indexed by PARAM_CLOCK_DIV
+constexpr const std::array<int, 6> kClockDivisions = {{1, 2, 3, 4, 6, 8}};
+constexpr const int kClockDefaultDivision = 3;
+// Sequencer ticks per clock edge, negative = one tick every n edges. Indexed by PARAM_CLOCK_RATE
+constexpr const std::array<int, 7> kClockRates = {{-4, -3, -2, 1, 2, 3, 4}};
+constexpr const int kClockDefaultRate = 3;
+constexpr const float kMinRateTickSamples = 4.0;
+// Samples a reset may arrive after a clock edge and still count as coincident with it
+constexpr const std::array<int, 6> kResetWindows = {{0, 1, 2, 4, 8, 16}};
+constexpr const int kResetDefaultWindow = 2;
+// Record latency compensation in ms, indexed by m_rec_latency
+constexpr const std::array<int, 7> kRecLatenciesMs = {{0, 5, 10, 15, 20, 30, 50}};
+// Record hits waiting for the widget, a power of two for dsp::RingBuffer
+constexpr const int kRecHitQueueSize = 32;
+
+// Algorithmic gate modes, fill and shift CV span all 16 steps over 10V
+constexpr const float kAlgoCvStepsPerVolt = 1.6;
+
+// Song mode, pattern bank slots and maximum song list entries
+constexpr const int kSongSlots = 8;
+constexpr const int kSongEntries = 32;
+constexpr const int kSongMaxRepeat = 16;
+// Song list edits queued by the UI, a power of two for dsp::RingBuffer
+constexpr const int kSongEditQueueSize = 16;
+
+// Step CV inputs, sampled on clock edges. Polyphonic cables address step n with channel n.
+constexpr const float kProbCvPercentPerVolt = 10.0;
+constexpr const float kLenCvStepsPerVolt = 1.6;
+constexpr const float kElenCvPerVolt = 0.5;
+
+// End-of-cycle trigger length, playhead CV scale. Steps use the INP_POS scale, so the playhead
+// can drive the start position of another instance.
+constexpr const float kEndTriggerTime = 1e-3;
+constexpr const float kPlayheadStepVolts = 5.0 / 16.0;
+constexpr const float kPlayheadLoopVolts = 1.0;
+
+// One published version of a linked group, see PatternLinks.hpp
+struct SharedPattern;
 
 struct HardSeqs : Module 
 {
@@ -65,6 +126,28 @@ struct HardSeqs : Module
 
     PARAM_LABEL,
 
+    PARAM_ALGO_MODE,
+    PARAM_ALGO_FILL,
+    PARAM_ALGO_SHIFT,
+    PARAM_MORPH,
+    PARAM_CLOCK_SOURCE,
+    PARAM_BPM,
+    PARAM_CLOCK_DIV,
+    PARAM_STEP_GLIDE,
+    PARAM_GLIDE_TIME,
+    PARAM_STEP_DURATION,
+    PARAM_CLOCK_RATE,
+    PARAM_STEP_ACCENT,
+    PARAM_STEP_LANE5,
+    PARAM_STEP_LANE6,
+    PARAM_STEP_LANE7,
+    PARAM_STEP_LANE8,
+    PARAM_REC,
+    PARAM_STEP_COND,
+    PARAM_DIRECTION,
+    PARAM_STEP_CYCLE_A,
+    PARAM_STEP_CYCLE_B,
+
     PARAM_COUNT
   };
 
@@ -75,6 +158,20 @@ struct HardSeqs : Module
     INP_CLOCK,
     INP_RST,
 
+    INP_ALGO_FILL,
+    INP_ALGO_SHIFT,
+    INP_MORPH,
+    INP_PROB,
+    INP_MOD1,
+    INP_MOD2,
+    INP_MOD3,
+    INP_LEN,
+    INP_ELEN,
+    INP_REC,
+    INP_REC_CV,
+    INP_FILL,
+    INP_ADDR,
+
     INP_COUNT
   };
 
@@ -102,6 +199,13 @@ struct HardSeqs : Module
     OUT_MOD2,
     OUT_MOD3,
 
+    OUT_CLOCK,
+    OUT_LANES,
+    OUT_EOL,
+    OUT_END_ELEN,
+    OUT_END_REPEAT,
+    OUT_PLAYHEAD,
+
     OUT_COUNT
   };
 
@@ -129,25 +233,126 @@ struct HardSeqs : Module
     LED_COUNT
   };
 
+  enum AlgoModes {
+    ALGO_MANUAL,
+    ALGO_EUCLID,
+    ALGO_DENSITY_RAMP,
+    ALGO_MARKOV,
+
+    ALGO_COUNT
+  };
+
+  // Step order of a loop, switched at the loop boundary
+  enum Directions {
+    DIR_FORWARD,
+    DIR_REVERSE,
+    DIR_PING_PONG,
+    DIR_ODD_EVEN,
+    DIR_SHUFFLE,
+    DIR_RANDOM_WALK,
+    DIR_CV,
+
+    DIR_COUNT
+  };
+
+  // Per-step trig conditions, checked after ELEN and probability
+  enum TrigConditions {
+    TRIG_ALWAYS,
+    TRIG_FILL,
+    TRIG_NOT_FILL,
+    TRIG_FIRST,
+    TRIG_NOT_FIRST,
+    TRIG_PREV,
+    TRIG_NOT_PREV,
+    // plays on loop cycle_a of every cycle_b loops since reset
+    TRIG_CYCLE,
+
+    TRIG_COUNT
+  };
+
+  // Song list edits, applied by the audio thread
+  enum SongEdits {
+    SONG_ADD,
+    SONG_SET,
+    SONG_REMOVE,
+    SONG_STORE,
+    SONG_MODE,
+  };
+
   struct StepEntry {
     bool is_enabled = kStepDefaultEnabled;
 
     std::array<bool, kLenEach> each_n = {kStepDefaultEach1, kStepDefaultEach2, kStepDefaultEach3, kStepDefaultEach4, kStepDefaultEach5};
     int len_each_n = kStepDefaultElen;
-    int cur_n = 0;
 
     int prob = kStepDefaultProb;
-    float mod1 = kStepDefaultMod1;
-    float mod2 = kStepDefaultMod2;
-    float mod3 = kStepDefaultMod3;
+    // one value per lane, contiguous so an edge loads them as kLaneVectors float_4
+    std::array<float, kValueLanes> values = {{kStepDefaultMod1, kStepDefaultMod2, kStepDefaultMod3, 0.0, 0.0, 0.0, 0.0, 0.0}};
+    bool is_glide = false;
+    // clock ticks the step lasts, 1..kMaxStepTicks
+    int duration = 1;
+    int condition = TRIG_ALWAYS;
+    int cycle_a = 1;
+    int cycle_b = 1;
 
-    void incrementLoop();
-    bool isTrigger() const;
+    // Field access by PARAM_STEP_* id
+    float field(int param_id) const;
+    void setField(int param_id, float value);
 
     StepEntry() = default;
   };
 
+  using StepTable = std::array<StepEntry, kLenSteps>;
+
+  // One song list entry, plays bank slot `slot` `repeat` times over len steps from start
+  struct SongEntry {
+    uint8_t slot = 0;
+    uint8_t repeat = 1;
+    uint8_t len = kLenSteps;
+    uint8_t start = 0;
+  };
+
+  // One song edit, index is the entry (SONG_SET, SONG_REMOVE), the slot (SONG_STORE) or
+  // the new song mode (SONG_MODE). SONG_ADD appends entry with the slot of the last entry.
+  struct SongEdit {
+    int command = SONG_ADD;
+    int index = 0;
+    SongEntry entry;
+    PackedPattern pattern;
+  };
+
+  // Song storage, only allocated once the instance uses song mode. bank and steps belong to the
+  // audio thread, bank_copy to the UI, edits carry SongEdits from the UI to the audio thread.
+  struct SongTables {
+    std::array<PackedPattern, kSongSlots> bank;
+    std::array<PackedPattern, kSongSlots> bank_copy;
+    std::array<StepTable, 2> steps;
+    dsp::RingBuffer<SongEdit, kSongEditQueueSize> edits;
+  };
+
+  // What the UI sees of the song, published by whoever changed it. play_version counts the
+  // entries started so far, play_slot is the bank slot of the one playing.
+  struct SongSnapshot {
+    std::array<SongEntry, kSongEntries> entries;
+    int count = 0;
+    int pos = 0;
+    bool is_song_mode = false;
+    uint32_t play_version = 0;
+    int play_slot = 0;
+  };
+
+  // One recorded hit, lane -1 only turns the gate on
+  struct RecHit {
+    int step = 0;
+    int lane = -1;
+    float value = 0.0;
+  };
+
+  // All value lanes of one step as volts
+  using LaneVector = std::array<simd::float_4, kLaneVectors>;
+
   HardSeqs();
+  ~HardSeqs();
   void process(const ProcessArgs &args) override;
 
   void setSelectedStep(int step);
@@ -157,9 +362,90 @@ struct HardSeqs : Module
   void clearAllStepOutputs();
   void resetSteps();
   void generateRandomGateSequence(int temp);
+  void generateConstrainedGateSequence();
+  void applyGateMask(uint16_t mask);
+  uint16_t gateMask() const;
+  void updateAlgoMask(int len);
+  int algoControl(int param_id, int input_id, int max_val);
+  void drawMarkovGate(int step);
+  bool isStepGateOn(int step) const;
+  uint16_t displayedGateMask() const;
+  void updateMorphAmount();
+  StepTable& allocMorphSteps();
+  const StepEntry& morphStep(int step) const;
+  void storeMorphTarget();
+  void swapMorphTarget();
+  void shuffleMorphThresholds();
+  PackedPattern packSteps() const;
+  void unpackSteps(const PackedPattern &pattern);
+  static PackedPattern packStepArray(const StepTable &steps);
+  static void unpackStepArray(const PackedPattern &pattern, StepTable &steps);
+  void setLinkGroup(int group, bool is_publish = false);
+  void publishLinkedSteps();
+  bool syncLinkedSteps();
+  void applyLinkedSteps(int group);
+  void releaseLinkedSteps();
+  bool processInternalClock(const ProcessArgs &args, bool is_ext_edge);
+  bool processClockRate(bool is_clock_edge, bool &is_tick_high);
+  void updateTickMap();
+  void buildTickMap();
+  int orderPosAt(int tick) const;
+  void buildStepOrder(int len);
+  void beginLoop(int len);
+  void updateTrigConditions();
+  uint16_t trigConditionMask(bool is_fill) const;
+  void recordHit(float sample_rate, bool is_chain);
+  int recordNextStep(bool is_chain) const;
+  void rollProbabilityMask();
+  void rerollProbabilityMask();
+  float stepCv(int input_id, int step);
+  int sequenceLength(bool is_song);
+  void updateElenCv();
+  void incrementLoop(int step, int len);
+  bool isLoopTrigger(int step) const;
+  static int valueLane(int param_id);
+  static int laneParam(int lane);
+  void laneVoltages(const StepEntry &entry, const StepEntry &morph_entry, LaneVector &volts);
+  void setLaneOutputs(const LaneVector &target, bool is_glide, float sample_rate);
+  void writeLaneOutputs(const LaneVector &volts);
+  void processGlide();
+  void processEndTriggers(float sample_time);
+  void writePlayhead();
+  const BusMessage* busMessageFromLeft();
+  int busChainLenRight();
+  void publishBus(const BusMessage &message, int chain_len_right);
+  void onAdd(const AddEvent &e) override;
+  void onRemove(const RemoveEvent &e) override;
+  void setRemoteControl(bool is_enabled);
+  void applyControlMessages();
+  SongTables& allocSongTables();
+  SongTables& songTables() const;
+  void startSong();
+  void prepareSongEntry();
+  void advanceSong();
+  void loadSongEntry(int pos);
+  void playSongSteps();
+  void stopSongSteps();
+  void publishSongSnapshot();
+  bool adoptSongSteps();
+  void storeSongSlot(int slot);
+  void loadSongSlot(int slot);
+  void addSongEntry();
+  void setSongEntry(int index, const SongEntry &entry);
+  void removeSongEntry(int index);
+  void setSongMode(bool is_enabled);
+  void queueSongEdit(const SongEdit &edit);
+  void flushSongEdits();
+  void applySongEdits();
+  void markSongChanged();
 
   json_t* dataToJson() override;
   void dataFromJson(json_t* root_json) override;
+  json_t* playheadToJson() const;
+  void playheadFromJson(json_t* playhead);
+  void fastForward(uint64_t ticks);
+  void fastForwardSong(uint64_t ticks);
+  void setLoopPosition(uint64_t passes);
 
   SynthDevKit::CV m_cv_run {kCvThreshold};
   SynthDevKit::CV m_cv_clock {kCvThreshold};
@@ -172,9 +458,191 @@ struct HardSeqs : Module
 
   uint8_t m_cur_loop = 0;
 
+  // Internal clock, phase runs 0..1 per tick
+  double m_clock_phase = 0.0;
+  double m_clock_inc = 0.0;
+  int m_clock_tick_in_beat = 0;
+  bool m_clock_sync = false;
+
+  // Reset/clock coincidence window, index into kResetWindows. A reset up to that many samples
+  // after a clock edge is applied before it: the state the edge changed is restored from the
+  // snapshot and the edge is played again from the reset position.
+  int m_reset_window = kResetDefaultWindow;
+  int m_samples_since_edge = kResetWindows.back() + 1;
+  uint8_t m_edge_cur_loop = 0;
+  bool m_edge_is_running = false;
+
+  // Gates produced by the algorithmic modes, indexed by absolute step. Markov mode draws the
+  // gate of a step once when the step starts.
+  uint16_t m_algo_mask = 0;
+  bool m_algo_last_gate = false;
+
   RandomGenerator rand_gen_;
 
-  std::array<StepEntry, kLenSteps> m_steps = 
+  // Probability outcome of every step for the current loop, rolled at the loop wrap.
+  // Frozen masks are kept until unfrozen so a variation can be locked in.
+  // The rolls are kept as well so the PROB input can move the threshold at the edge.
+  uint16_t m_prob_mask = 0xFFFF;
+  std::array<uint8_t, kLenSteps> m_prob_rolls {};
+  bool m_is_prob_frozen = false;
+  std::atomic<bool> m_is_reroll_pending {false};
+
+  // ELEN from the ELEN input per step, -1 = use the step's own ELEN. Refreshed at the loop wrap.
+  std::array<int8_t, kLenSteps> m_cv_elen;
+  // ELEN iteration of every step in the current loop
+  std::array<uint8_t, kLenSteps> m_cur_n {};
+
+  // Mod output quantizer per lane, scale -1 = off. Applied once per step edge.
+  std::array<int8_t, kModOutputs> m_quant_scale = {{-1, -1, -1}};
+  std::array<int8_t, kModOutputs> m_quant_root = {{0, 0, 0}};
+
+  // Expander bus. A follower takes clock, reset and run from the HardSeqs on its left, a
+  // chained module also continues its step sequence (32/48/64 steps for 2/3/4 modules).
+  bool m_bus_follow = false;
+  bool m_bus_chain = false;
+  std::array<BusMessage, 2> m_bus_from_left;
+  std::array<BusReply, 2> m_bus_from_right;
+  // Next chain playhead, only used by the chain leader (left-most module of a chain)
+  int m_chain_pos = 0;
+  // Steps this module plays per pass, from the last clock edge
+  int m_own_len = kLenSteps;
+
+  // Channels of OUT_LANES, the first m_lane_count lanes
+  int m_lane_count = kValueLanes;
+
+  // A glide ramps all lanes linearly towards the target for m_glide_samples samples,
+  // otherwise the outputs are only written on edges.
+  LaneVector m_glide_value {};
+  LaneVector m_glide_target {};
+  LaneVector m_glide_inc {};
+  int m_glide_samples = 0;
+
+  // Triggers of OUT_EOL, OUT_END_ELEN and OUT_END_REPEAT, written only when a pulse starts or ends.
+  // The playhead output follows the last started step and the loop it started in.
+  std::array<dsp::PulseGenerator, 3> m_end_pulses;
+  std::array<bool, 3> m_end_high {};
+  int m_playhead_step = -1;
+  int m_playhead_loop = -1;
+
+  // Trig conditions compiled into one step mask per condition, rebuilt on the first tick after a
+  // condition changed. A step is blocked when its bit is set in the mask of a condition that
+  // does not hold, so an edge needs three lookups and two ORs.
+  std::array<uint16_t, TRIG_COUNT> m_cond_masks {};
+  std::array<uint8_t, kLenSteps> m_cond_compiled {};
+  // TRIG_CYCLE: A:B per step as packed by packStepArray(), and the steps of m_cond_masks[TRIG_CYCLE]
+  // that play in the loop m_cycle_compiled_loop
+  std::array<uint8_t, kLenSteps> m_cycle_compiled {};
+  uint16_t m_cycle_pass_mask = 0;
+  uint32_t m_cycle_compiled_loop = 0;
+  SynthDevKit::CV m_cv_fill {kCvThreshold};
+  // loops since reset, unlike m_cur_loop not restarted by song entries
+  uint32_t m_loop_count = 0;
+  bool m_is_first_loop = true;
+  bool m_is_prev_fired = false;
+
+  // Step order of the current loop as absolute steps, built at the loop boundary from
+  // PARAM_DIRECTION, start position and length. Random orders are drawn again every loop.
+  std::array<uint8_t, kMaxOrderLen> m_order {};
+  int m_order_len = 1;
+  int m_order_direction = DIR_FORWARD;
+  // Order position playing and steps played this loop, they only differ for DIR_CV
+  int m_order_pos = 0;
+  int m_order_step = 0;
+  int m_walk_pos = 0;
+
+  // First tick of every order position, rebuilt with the order and on the first tick after a step
+  // duration changed. Position p plays ticks m_order_first_tick[p] .. m_order_first_tick[p + 1] - 1.
+  std::array<uint16_t, kMaxOrderLen + 1> m_order_first_tick {};
+  std::array<uint8_t, kLenSteps> m_tick_map_durations {};
+  int m_tick_pos = 0;
+
+  // Step recording. Hits on INP_REC go to the nearest step start: the last played step, the one
+  // before it or the next one. The audio thread queues them in m_rec_hits, the widget applies them
+  // to m_steps, publishes them and turns each record pass into one undo entry. Periods are in
+  // samples, measured from one step start to the next. A hit on a next step that is not known yet
+  // (end of the loop, address CV, chain) waits in m_rec_pending for that step to start.
+  SynthDevKit::CV m_cv_rec {kCvThreshold};
+  int m_rec_lane = -1;
+  int m_rec_latency = 0;
+  int m_rec_last_step = -1;
+  int m_rec_prev_step = -1;
+  int m_rec_since_step = 0;
+  int m_rec_step_period = 0;
+  int m_rec_tick_period = 0;
+  int m_rec_last_ticks = 1;
+  bool m_is_rec_pending = false;
+  RecHit m_rec_pending;
+  dsp::RingBuffer<RecHit, kRecHitQueueSize> m_rec_hits;
+
+  // PARAM_CLOCK_RATE state. The divider counts edges, the multiplier spreads its extra ticks
+  // over the previous clock period (-1 = not measured yet).
+  int m_rate_edges = 0;
+  int m_rate_since_edge = -1;
+  int m_rate_since_tick = 0;
+  int m_rate_subticks = 0;
+  float m_rate_tick_len = 0.0;
+
+  // Morph target (slot B), the live steps are slot A. A step takes its gate from B once
+  // the morph amount reaches its threshold, mods are crossfaded. The target is allocated by the
+  // UI when one is first stored or loaded, until then B plays as empty steps.
+  std::atomic<StepTable*> m_morph_steps {nullptr};
+  std::array<float, kLenSteps> m_morph_thresholds;
+  float m_morph_amount = 0.0;
+
+  // Song mode plays m_song[0..m_song_count) in order. The list, bank, mode and song tables
+  // belong to the audio thread. The UI queues edits, keeps its own copy of the bank and reads
+  // the list from m_song_snapshot. Edits that found the queue full wait in m_song_edits_unsent
+  // until the widget flushes them again. The UI allocates m_song_tables before it queues the
+  // first edit or loads a song, process() loads it with acquire before touching the song.
+  // An entry plays from m_song_tables->steps[m_song_play_index] through m_play_steps, the entry
+  // after it is unpacked into the other table ahead of time, so the switch at the loop boundary
+  // only moves the pointer. The widget copies every new entry into m_steps and acknowledges its
+  // play version in m_song_adopted_version, from then on the entry plays from m_steps and knob
+  // edits are heard.
+  bool m_is_song_mode = false;
+  std::atomic<SongTables*> m_song_tables {nullptr};
+  std::array<SongEntry, kSongEntries> m_song;
+  int m_song_count = 0;
+  int m_song_pos = 0;
+  uint8_t m_song_pass = 0;
+  std::atomic<bool> m_song_next_ready {false};
+  int m_song_next_pos = 0;
+  uint16_t m_song_next_prob_mask = 0xFFFF;
+  std::array<uint8_t, kLenSteps> m_song_next_prob_rolls {};
+  int m_song_play_index = 0;
+  uint32_t m_song_play_version = 0;
+  std::atomic<uint32_t> m_song_adopted_version {0};
+  TripleBuffer<SongSnapshot> m_song_snapshot;
+  std::deque<SongEdit> m_song_edits_unsent;
+
+  // Linked instances play the current SharedPattern of their PatternLinks group in place, -1 = not
+  // linked. m_play_steps is what process() reads: the group's table, a song table, or m_steps once
+  // the widget adopted a song entry or the instance left the group. m_link_version is the version the audio thread may
+  // still read. On the UI side m_steps is the copy edits start from, taken when the group moved on.
+  std::atomic<int> m_link_group {-1};
+  std::atomic<uint64_t> m_link_version;
+  const SharedPattern *m_link_pattern = nullptr;
+  const StepTable *m_play_steps = &m_steps;
+  uint64_t m_link_copy_version = 0;
+
+  // Remote control over ControlSocket. The inbox only exists while remote control is on, the
+  // widget applies its messages and hands a fast forward on to process().
+  bool m_is_remote = false;
+  std::unique_ptr<ControlInbox> m_control_inbox;
+  std::atomic<uint64_t> m_fast_forward_ticks {0};
+  std::atomic<bool> m_is_fast_forward_pending {false};
+
+  #ifdef HS_PROFILE
+  ProcessProfile m_profile;
+  #endif
+
+  // Constrained generator searches on the shared worker pool, the widget polls m_gen_job and
+  // applies the result as an undoable edit
+  PatternConstraints m_gen_constraints;
+  bool m_gen_avoid_left = false;
+  std::shared_ptr<PatternGenerator::Job> m_gen_job;
+
+  StepTable m_steps = 
   {
     StepEntry(), StepEntry(), StepEntry(), StepEntry(),
     StepEntry(), StepEntry(), StepEntry(), StepEntry(),
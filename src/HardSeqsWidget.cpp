@@ -18,12 +18,24 @@
  */
 
 #include "HardSeqs.hpp"
+#include "PatternLibrary.hpp"
+#include "PatternLinks.hpp"
+#include "StepHistory.hpp"
 
 #include "UiComponents.hpp"
 
+#include <osdialog.h>
+
 #include <iostream>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Same order as the PARAM_LABEL sprites, used as pattern library tags
+static const std::array<std::string, 11> kLabelNames = {
+    "KIK1", "KIK2", "CHAT1", "CHAT2", "OHAT", "SNR1", "SNR2", "TOM1", "PERC", "KEY1", "KEY2"
+};
 
 
 struct HardSeqsWidget : ModuleWidget 
@@ -33,11 +45,29 @@ struct HardSeqsWidget : ModuleWidget
         std::uint64_t m_start_time;
         SpriteSwitcher *m_label {nullptr};
 
+        // Steps at the start of a knob drag, the whole drag becomes one undo entry
+        HardSeqs::StepTable m_edit_before;
+        bool m_is_dragging {false};
+
+        // Steps when recording was switched on, a record pass becomes one undo entry
+        HardSeqs::StepTable m_rec_before;
+        bool m_is_recording {false};
+        bool m_has_rec_edits {false};
+
     public:
         HardSeqsWidget(HardSeqs *module);
 
+        void step() override;
         void stepSwitchHandler(int step_idx);
         void appendContextMenu(Menu *menu) override;
+        void appendLibraryMenu(Menu *menu);
+        void appendLibraryIndexMenu(Menu *menu, PatternLibrary::Index index);
+        void loadLibraryRecord(PatternLibrary::Index index, uint32_t n);
+        void stepEditHandler(int param_id);
+        void stepDragHandler(int param_id, bool is_start);
+        void editSteps(const std::string &name, const std::function<void()> &edit);
+        void appendSongMenu(Menu *menu);
+        void appendSongEntryMenu(Menu *menu, int index);
 };
 
 HardSeqsWidget::HardSeqsWidget(HardSeqs *module) 
@@ -45,7 +75,7 @@ HardSeqsWidget::HardSeqsWidget(HardSeqs *module)
     m_module = module;
 
     setModule(module);
-    box.size = Vec(20 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT);
+    box.size = Vec(26 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT);
     setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/HardSeqs.svg")));
 
     /* -- Top Panel Rect Start -- */
@@ -112,6 +142,90 @@ HardSeqsWidget::HardSeqsWidget(HardSeqs *module)
     }
     /* Right panel rect end */
 
+    /* Extension panel rect start */
+    constexpr const float kExtLeftX = 308.0;
+    constexpr const float kExtTopY = 22.0;
+    constexpr const float kExtShiftX = 25.0;
+    constexpr const float kExtShiftY = 32.0;
+
+    {
+        // Algorithmic gate fill & shift
+        auto algo_fill = createParam<LightKnobSmall>(Vec(kExtLeftX, kExtTopY), module, HardSeqs::PARAM_ALGO_FILL);
+        algo_fill->snap = true;
+        addParam(algo_fill);
+
+        auto algo_shift = createParam<LightKnobSmall>(Vec(kExtLeftX + kExtShiftX, kExtTopY), module, HardSeqs::PARAM_ALGO_SHIFT);
+        algo_shift->snap = true;
+        addParam(algo_shift);
+
+        addInput(createInput<SmallPort>(Vec(kExtLeftX, kExtTopY + kExtShiftY), module, HardSeqs::INP_ALGO_FILL));
+        addInput(createInput<SmallPort>(Vec(kExtLeftX + kExtShiftX, kExtTopY + kExtShiftY), module, HardSeqs::INP_ALGO_SHIFT));
+
+        // Morph amount
+        addParam(createParam<LightKnobSmall>(Vec(kExtLeftX + 2 * kExtShiftX, kExtTopY), module, HardSeqs::PARAM_MORPH));
+        addInput(createInput<SmallPort>(Vec(kExtLeftX + 2 * kExtShiftX, kExtTopY + kExtShiftY), module, HardSeqs::INP_MORPH));
+
+        // Internal clock tempo & clock out
+        addParam(createParam<LightKnobSmall>(Vec(kExtLeftX, kExtTopY + 2 * kExtShiftY), module, HardSeqs::PARAM_BPM));
+        addOutput(createOutput<SmallPort>(Vec(kExtLeftX + kExtShiftX, kExtTopY + 2 * kExtShiftY), module, HardSeqs::OUT_CLOCK));
+
+        // Playhead: step & loop as poly CV
+        addOutput(createOutput<SmallPort>(Vec(kExtLeftX + 2 * kExtShiftX, kExtTopY + 2 * kExtShiftY), module, HardSeqs::OUT_PLAYHEAD));
+
+        // Step CV: probability, length & ELEN, then mod1..3 offsets
+        addInput(createInput<SmallPort>(Vec(kExtLeftX, kExtTopY + 3 * kExtShiftY), module, HardSeqs::INP_PROB));
+        addInput(createInput<SmallPort>(Vec(kExtLeftX + kExtShiftX, kExtTopY + 3 * kExtShiftY), module, HardSeqs::INP_LEN));
+        addInput(createInput<SmallPort>(Vec(kExtLeftX + 2 * kExtShiftX, kExtTopY + 3 * kExtShiftY), module, HardSeqs::INP_ELEN));
+
+        for (int i = 0; i < 3; ++i)
+            addInput(createInput<SmallPort>(Vec(kExtLeftX + i * kExtShiftX, kExtTopY + 4 * kExtShiftY), module, HardSeqs::INP_MOD1 + i));
+
+        // Glide flag of the selected step & glide time
+        auto step_glide = createParam<LightSwitch>(Vec(kExtLeftX, kExtTopY + 5 * kExtShiftY), module, HardSeqs::PARAM_STEP_GLIDE);
+        step_glide->setCallback(std::bind(&HardSeqsWidget::stepEditHandler, this, std::placeholders::_1));
+        addChild(step_glide);
+
+        addParam(createParam<LightKnobSmall>(Vec(kExtLeftX + kExtShiftX, kExtTopY + 5 * kExtShiftY), module, HardSeqs::PARAM_GLIDE_TIME));
+
+        // Duration of the selected step in clock ticks
+        auto step_duration = createParam<CustomLightKnob>(Vec(kExtLeftX + 2 * kExtShiftX, kExtTopY + 5 * kExtShiftY), module, HardSeqs::PARAM_STEP_DURATION);
+        step_duration->setCallback(std::bind(&HardSeqsWidget::stepEditHandler, this, std::placeholders::_1));
+        step_duration->setDragCallback(std::bind(&HardSeqsWidget::stepDragHandler, this, std::placeholders::_1, std::placeholders::_2));
+        addChild(step_duration);
+
+        // Accent & lanes 5..8 of the selected step, all lanes as poly out
+        for (int i = 0; i <= HardSeqs::PARAM_STEP_LANE8 - HardSeqs::PARAM_STEP_ACCENT; ++i) {
+            const Vec pos(kExtLeftX + (i % 3) * kExtShiftX, kExtTopY + (6 + i / 3) * kExtShiftY);
+            auto step_lane = createParam<CustomLightSnapFreeKnob>(pos, module, HardSeqs::PARAM_STEP_ACCENT + i);
+            step_lane->setCallback(std::bind(&HardSeqsWidget::stepEditHandler, this, std::placeholders::_1));
+            step_lane->setDragCallback(std::bind(&HardSeqsWidget::stepDragHandler, this, std::placeholders::_1, std::placeholders::_2));
+            addChild(step_lane);
+        }
+
+        addOutput(createOutput<SmallPort>(Vec(kExtLeftX + 2 * kExtShiftX, kExtTopY + 7 * kExtShiftY), module, HardSeqs::OUT_LANES));
+
+        // Step recording: gate & CV inputs, record switch
+        addInput(createInput<SmallPort>(Vec(kExtLeftX, kExtTopY + 8 * kExtShiftY), module, HardSeqs::INP_REC));
+        addInput(createInput<SmallPort>(Vec(kExtLeftX + kExtShiftX, kExtTopY + 8 * kExtShiftY), module, HardSeqs::INP_REC_CV));
+
+        auto rec_switch = createParam<LightSwitch>(Vec(kExtLeftX + 2 * kExtShiftX, kExtTopY + 8 * kExtShiftY), module, HardSeqs::PARAM_REC);
+        rec_switch->setCallback([this] (int param_id)
+        {
+            if (m_module)
+                m_module->getParam(param_id).setValue(m_module->getParam(param_id).value == 0.0 ? 1.0 : 0.0);
+        });
+        addChild(rec_switch);
+
+        // End of loop, ELEN cycle & repeat triggers
+        for (int i = 0; i < 3; ++i)
+            addOutput(createOutput<SmallPort>(Vec(kExtLeftX + i * kExtShiftX, kExtTopY + 9 * kExtShiftY), module, HardSeqs::OUT_EOL + i));
+
+        // Fill gate for the fill trig conditions, step address for the CV address direction
+        addInput(createInput<SmallPort>(Vec(kExtLeftX, kExtTopY + 10 * kExtShiftY), module, HardSeqs::INP_FILL));
+        addInput(createInput<SmallPort>(Vec(kExtLeftX + kExtShiftX, kExtTopY + 10 * kExtShiftY), module, HardSeqs::INP_ADDR));
+    }
+    /* Extension panel rect end */
+
     /* StepButtons Start */
     constexpr const int kSwitchInRow = 4;
     constexpr const int kSwitchInCol = 4;
@@ -153,7 +267,7 @@ HardSeqsWidget::HardSeqsWidget(HardSeqs *module)
 
     /* Step Bottom Panel Start*/
     auto step_switch_step_enabled = createParam<LightSwitch>(Vec(85.0, 269.0), module, HardSeqs::ParamIds::PARAM_STEP_ENABLED);
-    step_switch_step_enabled->setCallback(std::bind(&HardSeqs::stepParamChangedHandler, m_module, std::placeholders::_1));
+    step_switch_step_enabled->setCallback(std::bind(&HardSeqsWidget::stepEditHandler, this, std::placeholders::_1));
     addChild(step_switch_step_enabled);
 
     constexpr const int kEachLen = 5;
@@ -164,31 +278,36 @@ HardSeqsWidget::HardSeqsWidget(HardSeqs *module)
     int cur_each_len_id = HardSeqs::ParamIds::PARAM_STEP_EACH1;
     for (int i = 0; i < kEachLen; ++i) {
         auto step_each_n = createParam<LightSwitch>(Vec(kEachLeftX + i * kShiftEachStepX, kEachLeftY), module, cur_each_len_id);
-        step_each_n->setCallback(std::bind(&HardSeqs::stepParamChangedHandler, m_module, std::placeholders::_1));
+        step_each_n->setCallback(std::bind(&HardSeqsWidget::stepEditHandler, this, std::placeholders::_1));
         addChild(step_each_n);
 
         cur_each_len_id += 1;
     }
 
     auto step_prob = createParam<CustomLightKnob>(Vec(80.5, 321.5), module, HardSeqs::ParamIds::PARAM_STEP_PROB);
-    step_prob->setCallback(std::bind(&HardSeqs::stepParamChangedHandler, module, std::placeholders::_1));
+    step_prob->setCallback(std::bind(&HardSeqsWidget::stepEditHandler, this, std::placeholders::_1));
+    step_prob->setDragCallback(std::bind(&HardSeqsWidget::stepDragHandler, this, std::placeholders::_1, std::placeholders::_2));
     addChild(step_prob);
 
     auto step_mod1 = createParam<CustomLightSnapFreeKnob>(Vec(139.0, 321.5), module, HardSeqs::ParamIds::PARAM_STEP_MOD1);
     step_mod1->snap = false;
-    step_mod1->setCallback(std::bind(&HardSeqs::stepParamChangedHandler, module, std::placeholders::_1));
+    step_mod1->setCallback(std::bind(&HardSeqsWidget::stepEditHandler, this, std::placeholders::_1));
+    step_mod1->setDragCallback(std::bind(&HardSeqsWidget::stepDragHandler, this, std::placeholders::_1, std::placeholders::_2));
     addChild(step_mod1);
 
     auto step_mod2 = createParam<CustomLightKnob>(Vec(191.0, 321.5), module, HardSeqs::ParamIds::PARAM_STEP_MOD2);
-    step_mod2->setCallback(std::bind(&HardSeqs::stepParamChangedHandler, module, std::placeholders::_1));
+    step_mod2->setCallback(std::bind(&HardSeqsWidget::stepEditHandler, this, std::placeholders::_1));
+    step_mod2->setDragCallback(std::bind(&HardSeqsWidget::stepDragHandler, this, std::placeholders::_1, std::placeholders::_2));
     addChild(step_mod2);
 
     auto step_mod3 = createParam<CustomLightKnob>(Vec(241.0, 321.5), module, HardSeqs::ParamIds::PARAM_STEP_MOD3);
-    step_mod3->setCallback(std::bind(&HardSeqs::stepParamChangedHandler, module, std::placeholders::_1));
+    step_mod3->setCallback(std::bind(&HardSeqsWidget::stepEditHandler, this, std::placeholders::_1));
+    step_mod3->setDragCallback(std::bind(&HardSeqsWidget::stepDragHandler, this, std::placeholders::_1, std::placeholders::_2));
     addChild(step_mod3);
 
     auto step_elen = createParam<CustomLightKnob>(Vec(241.0, 265.5), module, HardSeqs::ParamIds::PARAM_STEP_ELEN);
-    step_elen->setCallback(std::bind(&HardSeqs::stepParamChangedHandler, module, std::placeholders::_1));
+    step_elen->setCallback(std::bind(&HardSeqsWidget::stepEditHandler, this, std::placeholders::_1));
+    step_elen->setDragCallback(std::bind(&HardSeqsWidget::stepDragHandler, this, std::placeholders::_1, std::placeholders::_2));
     addChild(step_elen);
     /* Step Bottom Panel End */
 }
@@ -215,35 +334,540 @@ void HardSeqsWidget::appendContextMenu(Menu* menu)
 
     menu->addChild(new MenuSeparator());
 
+    menu->addChild(createSubmenuItem("Clock", "",
+    [this] (Menu *sub_menu)
+    {
+        sub_menu->addChild(createIndexSubmenuItem("Source", {"External", "Internal"},
+            [this] () { return static_cast<size_t>(m_module->getParam(HardSeqs::PARAM_CLOCK_SOURCE).value); },
+            [this] (size_t val) { m_module->getParam(HardSeqs::PARAM_CLOCK_SOURCE).setValue(static_cast<float>(val)); }));
+
+        sub_menu->addChild(createIndexSubmenuItem("Steps per beat", {"1", "2", "3", "4", "6", "8"},
+            [this] () { return static_cast<size_t>(m_module->getParam(HardSeqs::PARAM_CLOCK_DIV).value); },
+            [this] (size_t val) { m_module->getParam(HardSeqs::PARAM_CLOCK_DIV).setValue(static_cast<float>(val)); }));
+
+        sub_menu->addChild(createBoolPtrMenuItem("Sync internal clock to clock input (1 pulse = 1 beat)", "", &m_module->m_clock_sync));
+
+        sub_menu->addChild(createIndexSubmenuItem("Reset window (late resets apply to the last clock)", {"Off", "1 sample", "2 samples", "4 samples", "8 samples", "16 samples"},
+            [this] () { return static_cast<size_t>(m_module->m_reset_window); },
+            [this] (size_t val) { m_module->m_reset_window = static_cast<int>(val); }));
+
+        sub_menu->addChild(createIndexSubmenuItem("Ticks per clock", {"1/4", "1/3", "1/2", "1", "2", "3", "4"},
+            [this] () { return static_cast<size_t>(m_module->getParam(HardSeqs::PARAM_CLOCK_RATE).value); },
+            [this] (size_t val) { m_module->getParam(HardSeqs::PARAM_CLOCK_RATE).setValue(static_cast<float>(val)); }));
+    }));
+
+    menu->addChild(createSubmenuItem("Recording", "",
+    [this] (Menu *sub_menu)
+    {
+        sub_menu->addChild(createIndexSubmenuItem("Record CV into", {"Off", "Mod1", "Mod2", "Mod3", "Accent", "Lane5", "Lane6", "Lane7", "Lane8"},
+            [this] () { return static_cast<size_t>(m_module->m_rec_lane + 1); },
+            [this] (size_t val) { m_module->m_rec_lane = static_cast<int>(val) - 1; }));
+
+        std::vector<std::string> latency_labels;
+        for (const auto ms : kRecLatenciesMs)
+            latency_labels.push_back(std::to_string(ms) + " ms");
+
+        sub_menu->addChild(createIndexSubmenuItem("Latency compensation", latency_labels,
+            [this] () { return static_cast<size_t>(m_module->m_rec_latency); },
+            [this] (size_t val) { m_module->m_rec_latency = static_cast<int>(val); }));
+    }));
+
+    menu->addChild(createSubmenuItem("Expander bus", "",
+    [this] (Menu *sub_menu)
+    {
+        sub_menu->addChild(createBoolPtrMenuItem("Take clock, reset and run from left HardSeqs", "", &m_module->m_bus_follow));
+        sub_menu->addChild(createBoolPtrMenuItem("Chain steps after left HardSeqs", "", &m_module->m_bus_chain));
+    }));
+
+    #if defined(ARCH_LIN) || defined(ARCH_MAC)
+    menu->addChild(createSubmenuItem("Remote control", "",
+    [this] (Menu *sub_menu)
+    {
+        sub_menu->addChild(createMenuLabel("Module id " + std::to_string(m_module->id) + ", socket HardSeqs.sock in the Rack user folder"));
+        sub_menu->addChild(createBoolMenuItem("Accept patterns from the control socket", "",
+            [this] () { return m_module->m_is_remote; },
+            [this] (bool is_enabled) { m_module->setRemoteControl(is_enabled); }));
+    }));
+    #endif
+
+    menu->addChild(createSubmenuItem("Probability", "",
+    [this] (Menu *sub_menu)
+    {
+        sub_menu->addChild(createBoolPtrMenuItem("Freeze rolls (lock current variation)", "", &m_module->m_is_prob_frozen));
+        sub_menu->addChild(createMenuItem("Re-roll now", "",
+        [this] ()
+        {
+            m_module->m_is_reroll_pending.store(true);
+        }));
+    }));
+
+    menu->addChild(createSubmenuItem("Mod quantizer", "",
+    [this] (Menu *sub_menu)
+    {
+        std::vector<std::string> scale_labels = {"Off"};
+        for (const auto name : ScaleTables::kScaleNames)
+            scale_labels.push_back(name);
+
+        const std::vector<std::string> root_labels(ScaleTables::kRootNames.begin(), ScaleTables::kRootNames.end());
+
+        for (int lane = 0; lane < kModOutputs; ++lane) {
+            sub_menu->addChild(createSubmenuItem("Mod" + std::to_string(lane + 1), "",
+            [this, lane, scale_labels, root_labels] (Menu *lane_menu)
+            {
+                lane_menu->addChild(createIndexSubmenuItem("Scale", scale_labels,
+                    [this, lane] () { return static_cast<size_t>(m_module->m_quant_scale[lane] + 1); },
+                    [this, lane] (size_t val) { m_module->m_quant_scale[lane] = static_cast<int8_t>(val) - 1; }));
+
+                lane_menu->addChild(createIndexSubmenuItem("Root", root_labels,
+                    [this, lane] () { return static_cast<size_t>(m_module->m_quant_root[lane]); },
+                    [this, lane] (size_t val) { m_module->m_quant_root[lane] = static_cast<int8_t>(val); }));
+            }));
+        }
+    }));
+
+    menu->addChild(createIndexSubmenuItem("Lane output channels", {"1", "2", "3", "4", "5", "6", "7", "8"},
+        [this] () { return static_cast<size_t>(m_module->m_lane_count - 1); },
+        [this] (size_t val) { m_module->m_lane_count = static_cast<int>(val) + 1; }));
+
+    menu->addChild(createIndexSubmenuItem("Gate mode", {"Manual", "Euclidean", "Density ramp", "Markov"},
+        [this] () { return static_cast<size_t>(m_module->getParam(HardSeqs::PARAM_ALGO_MODE).value); },
+        [this] (size_t val) { m_module->getParam(HardSeqs::PARAM_ALGO_MODE).setValue(static_cast<float>(val)); }));
+
+    menu->addChild(createIndexSubmenuItem("Direction (from the next loop)", {"Forward", "Reverse", "Ping-pong", "Odd/even", "Shuffle", "Random walk", "CV address"},
+        [this] () { return static_cast<size_t>(m_module->getParam(HardSeqs::PARAM_DIRECTION).value); },
+        [this] (size_t val) { m_module->getParam(HardSeqs::PARAM_DIRECTION).setValue(static_cast<float>(val)); }));
+
+    std::vector<std::string> link_labels = {"Off"};
+    for (int i = 1; i <= kLinkGroups; ++i)
+        link_labels.push_back("Group " + std::to_string(i));
+
+    menu->addChild(createIndexSubmenuItem("Link pattern", link_labels,
+        [this] () { return static_cast<size_t>(m_module->m_link_group.load() + 1); },
+        [this] (size_t val) { m_module->setLinkGroup(static_cast<int>(val) - 1); }));
+
+    menu->addChild(createSubmenuItem("Selected step", "",
+    [this] (Menu *sub_menu)
+    {
+        sub_menu->addChild(createIndexSubmenuItem("Trig condition", {"Always", "Fill", "Not fill", "First loop", "Not first loop", "Previous step fired", "Previous step silent", "Cycle A:B"},
+            [this] () { return static_cast<size_t>(m_module->getParam(HardSeqs::PARAM_STEP_COND).value); },
+            [this] (size_t val)
+            {
+                m_module->getParam(HardSeqs::PARAM_STEP_COND).setValue(static_cast<float>(val));
+                stepEditHandler(HardSeqs::PARAM_STEP_COND);
+            }));
+
+        std::vector<std::string> cycle_labels;
+        for (int n = 1; n <= kMaxCycleLen; ++n)
+            cycle_labels.push_back(std::to_string(n));
+
+        // A and B of the "Cycle A:B" condition, the step plays on the A-th of every B loops
+        for (const int param_id : {HardSeqs::PARAM_STEP_CYCLE_A, HardSeqs::PARAM_STEP_CYCLE_B}) {
+            sub_menu->addChild(createIndexSubmenuItem(param_id == HardSeqs::PARAM_STEP_CYCLE_A ? "Cycle A" : "Cycle B", cycle_labels,
+                [this, param_id] () { return static_cast<size_t>(m_module->getParam(param_id).value - 1); },
+                [this, param_id] (size_t val)
+                {
+                    m_module->getParam(param_id).setValue(static_cast<float>(val + 1));
+                    stepEditHandler(param_id);
+                }));
+        }
+    }));
+
+    menu->addChild(createSubmenuItem("Morph target", "",
+    [this] (Menu *sub_menu)
+    {
+        sub_menu->addChild(createMenuItem("Store current steps as morph target", "",
+        [this] ()
+        {
+            m_module->storeMorphTarget();
+        }));
+        sub_menu->addChild(createMenuItem("Swap current steps with morph target", "",
+        [this] ()
+        {
+            editSteps("swap morph target", [this] () { m_module->swapMorphTarget(); });
+        }));
+        sub_menu->addChild(createMenuItem("Reshuffle morph gate order", "",
+        [this] ()
+        {
+            m_module->shuffleMorphThresholds();
+        }));
+    }));
+
+    menu->addChild(createSubmenuItem("Song", "",
+    [this] (Menu *sub_menu)
+    {
+        appendSongMenu(sub_menu);
+    }));
+
+    menu->addChild(createSubmenuItem("Pattern library", "",
+    [this] (Menu *sub_menu)
+    {
+        appendLibraryMenu(sub_menu);
+    }));
+
     menu->addChild(createMenuItem("Disable all gates","",
     [this] ()
     {
-        m_module->generateRandomGateSequence(0);
+        editSteps("random gates", [this] () { m_module->generateRandomGateSequence(0); });
     }));
     menu->addChild(createMenuItem("Generate random gate sequence (temp = 10)","",
     [this] ()
     {
-        m_module->generateRandomGateSequence(10);
+        editSteps("random gates", [this] () { m_module->generateRandomGateSequence(10); });
     }));
     menu->addChild(createMenuItem("Generate random gate sequence (temp = 25)","",
     [this] ()
     {
-        m_module->generateRandomGateSequence(25);
+        editSteps("random gates", [this] () { m_module->generateRandomGateSequence(25); });
     }));
     menu->addChild(createMenuItem("Generate random gate sequence (temp = 50)","",
     [this] ()
     {
-        m_module->generateRandomGateSequence(50);
+        editSteps("random gates", [this] () { m_module->generateRandomGateSequence(50); });
     }));
     menu->addChild(createMenuItem("Generate random gate sequence (temp = 75)","",
     [this] ()
     {
-        m_module->generateRandomGateSequence(75);
+        editSteps("random gates", [this] () { m_module->generateRandomGateSequence(75); });
     }));
     menu->addChild(createMenuItem("Generate random gate sequence (temp = 90)","",
     [this] ()
     {
-        m_module->generateRandomGateSequence(90);
+        editSteps("random gates", [this] () { m_module->generateRandomGateSequence(90); });
+    }));
+
+    menu->addChild(createSubmenuItem("Constrained gate generator", "",
+    [this] (Menu *sub_menu)
+    {
+        auto &constraints = m_module->m_gen_constraints;
+
+        std::vector<std::string> density_labels;
+        for (int i = 0; i <= kLenSteps; ++i)
+            density_labels.push_back(std::to_string(i));
+
+        sub_menu->addChild(createIndexSubmenuItem("Density", density_labels,
+            [&constraints] () { return static_cast<size_t>(constraints.density); },
+            [&constraints] (size_t val) { constraints.density = static_cast<int>(val); }));
+
+        sub_menu->addChild(createIndexSubmenuItem("Syncopation", {"Off", "Light", "Medium", "Heavy"},
+            [&constraints] () { return static_cast<size_t>(constraints.w_syncopation == 0.0 ? 0 : constraints.syncopation * 4.0); },
+            [&constraints] (size_t val) {
+                constraints.syncopation = val * 0.25;
+                constraints.w_syncopation = val == 0 ? 0.0 : 1.0;
+            }));
+
+        sub_menu->addChild(createBoolMenuItem("Euclidean fit", "",
+            [&constraints] () { return constraints.w_euclid != 0.0; },
+            [&constraints] (bool val) { constraints.w_euclid = val ? 1.0 : 0.0; }));
+
+        sub_menu->addChild(createBoolMenuItem("Stay close to current gates", "",
+            [&constraints] () { return constraints.w_similarity != 0.0; },
+            [&constraints] (bool val) { constraints.w_similarity = val ? 0.5 : 0.0; }));
+
+        sub_menu->addChild(createBoolMenuItem("Avoid left neighbour gates", "",
+            [this] () { return m_module->m_gen_avoid_left; },
+            [this] (bool val) {
+                m_module->m_gen_avoid_left = val;
+                m_module->m_gen_constraints.w_collision = val ? 2.0 : 0.0;
+            }));
+
+        sub_menu->addChild(new MenuSeparator());
+        sub_menu->addChild(createMenuItem("Generate", "",
+        [this] ()
+        {
+            m_module->generateConstrainedGateSequence();
+        }));
+    }));
+}
+
+static std::string selectLibraryFile(osdialog_file_action action)
+{
+    osdialog_filters *filters = osdialog_filters_parse("HardSeqs pattern library:hspl");
+    char *path_c = osdialog_file(action, nullptr, "patterns.hspl", filters);
+    osdialog_filters_free(filters);
+
+    if (!path_c)
+        return "";
+
+    std::string path = path_c;
+    std::free(path_c);
+
+    return path;
+}
+
+void HardSeqsWidget::appendLibraryMenu(Menu *menu)
+{
+    auto &library = PatternLibrary::shared();
+
+    menu->addChild(createMenuLabel(library.isOpen()
+        ? system::getFilename(library.path()) + " (" + std::to_string(library.size()) + " patterns)"
+        : "No library open"));
+
+    menu->addChild(createMenuItem("Open library...", "",
+    [] ()
+    {
+        const auto path = selectLibraryFile(OSDIALOG_OPEN);
+        if (!path.empty())
+            PatternLibrary::shared().open(path);
+    }));
+    menu->addChild(createMenuItem("New library...", "",
+    [] ()
+    {
+        const auto path = selectLibraryFile(OSDIALOG_SAVE);
+        if (!path.empty())
+            PatternLibrary::shared().create(path);
+    }));
+    menu->addChild(createMenuItem("Add current pattern", "",
+    [this] ()
+    {
+        auto &library = PatternLibrary::shared();
+        const auto label = static_cast<std::size_t>(m_module->getParam(HardSeqs::PARAM_LABEL).value);
+        const auto &tag = kLabelNames.at(std::min(label, kLabelNames.size() - 1));
+
+        library.append(tag + " " + std::to_string(library.size() + 1), tag, m_module->packSteps());
+    }, !library.isOpen()));
+
+    if (!library.isOpen())
+        return;
+
+    menu->addChild(new MenuSeparator());
+    menu->addChild(createSubmenuItem("By name", "",
+    [this] (Menu *sub_menu) { appendLibraryIndexMenu(sub_menu, PatternLibrary::INDEX_NAME); }));
+    menu->addChild(createSubmenuItem("By tag", "",
+    [this] (Menu *sub_menu) { appendLibraryIndexMenu(sub_menu, PatternLibrary::INDEX_TAG); }));
+    menu->addChild(createSubmenuItem("By density", "",
+    [this] (Menu *sub_menu) { appendLibraryIndexMenu(sub_menu, PatternLibrary::INDEX_DENSITY); }));
+}
+
+void HardSeqsWidget::appendLibraryIndexMenu(Menu *menu, PatternLibrary::Index index)
+{
+    auto &library = PatternLibrary::shared();
+
+    // Records sharing a group key are adjacent in the index, each group becomes one
+    // lazily built submenu
+    auto group_key = [&library, index] (uint32_t n) -> std::string {
+        const auto &record = library.record(index, n);
+
+        if (index == PatternLibrary::INDEX_NAME)
+            return std::string(1, record.name[0] ? record.name[0] : ' ');
+        if (index == PatternLibrary::INDEX_TAG)
+            return std::string(record.tag, strnlen(record.tag, kLibraryTagLen));
+
+        return std::to_string(record.density) + " gates";
+    };
+
+    uint32_t group_begin = 0;
+    while (group_begin < library.size()) {
+        const auto key = group_key(group_begin);
+
+        uint32_t group_end = group_begin + 1;
+        while (group_end < library.size() && group_key(group_end) == key)
+            group_end++;
+
+        menu->addChild(createSubmenuItem(key.empty() ? "-" : key, std::to_string(group_end - group_begin),
+        [this, index, group_begin, group_end] (Menu *sub_menu)
+        {
+            auto &library = PatternLibrary::shared();
+
+            for (uint32_t n = group_begin; n < group_end && n < library.size(); ++n) {
+                const auto &record = library.record(index, n);
+
+                sub_menu->addChild(createMenuItem(std::string(record.name, strnlen(record.name, kLibraryNameLen)), "",
+                [this, index, n] ()
+                {
+                    loadLibraryRecord(index, n);
+                }));
+            }
+        }));
+
+        group_begin = group_end;
+    }
+}
+
+void HardSeqsWidget::loadLibraryRecord(PatternLibrary::Index index, uint32_t n)
+{
+    const auto &library = PatternLibrary::shared();
+
+    if (n < library.size()) {
+        editSteps("load library pattern", [this, &library, index, n] ()
+        {
+            m_module->unpackSteps(library.record(index, n).pattern);
+            m_module->publishLinkedSteps();
+        });
+    }
+}
+
+void HardSeqsWidget::stepEditHandler(int param_id)
+{
+    if (!m_module)
+        return;
+
+    // knob drags are recorded as a whole by stepDragHandler
+    if (m_is_dragging) {
+        m_module->stepParamChangedHandler(param_id);
+        return;
+    }
+
+    editSteps("edit step", [this, param_id] () { m_module->stepParamChangedHandler(param_id); });
+}
+
+void HardSeqsWidget::stepDragHandler(int param_id, bool is_start)
+{
+    if (!m_module)
+        return;
+
+    if (is_start) {
+        m_edit_before = m_module->m_steps;
+        m_is_dragging = true;
+        return;
+    }
+
+    m_is_dragging = false;
+    pushStepEdit(m_module, m_edit_before, "edit step");
+}
+
+void HardSeqsWidget::step()
+{
+    ModuleWidget::step();
+
+    if (!m_module)
+        return;
+
+    const bool is_recording = m_module->getParam(HardSeqs::PARAM_REC).value > 0.0;
+    if (is_recording && !m_is_recording) {
+        m_rec_before = m_module->m_steps;
+        m_has_rec_edits = false;
+    }
+
+    if (!m_module->m_rec_hits.empty()) {
+        while (!m_module->m_rec_hits.empty()) {
+            const auto hit = m_module->m_rec_hits.shift();
+            auto &entry = m_module->m_steps[hit.step];
+
+            entry.is_enabled = true;
+            if (hit.lane >= 0)
+                entry.values[hit.lane] = hit.value;
+        }
+        m_has_rec_edits = true;
+
+        m_module->setSelectedStep(m_module->m_selected_step);
+        m_module->publishLinkedSteps();
+    }
+
+    if (!is_recording && m_is_recording && m_has_rec_edits)
+        pushStepEdit(m_module, m_rec_before, "record steps");
+
+    m_is_recording = is_recording;
+
+    // linked instances play the group's steps in place, the knobs follow its latest version
+    if (m_module->syncLinkedSteps())
+        m_module->setSelectedStep(m_module->m_selected_step);
+
+    // a song entry started, its steps become the ones the knobs edit
+    m_module->adoptSongSteps();
+
+    if (m_module->m_control_inbox && !m_module->m_control_inbox->empty())
+        editSteps("remote edit", [this] () { m_module->applyControlMessages(); });
+
+    if (!m_module->m_song_edits_unsent.empty())
+        m_module->flushSongEdits();
+
+    if (m_module->m_gen_job && m_module->m_gen_job->is_done.load(std::memory_order_acquire)) {
+        const uint16_t mask = m_module->m_gen_job->mask;
+        m_module->m_gen_job.reset();
+
+        editSteps("generate gates", [this, mask] () { m_module->applyGateMask(mask); });
+    }
+}
+
+void HardSeqsWidget::editSteps(const std::string &name, const std::function<void()> &edit)
+{
+    const HardSeqs::StepTable before = m_module->m_steps;
+    edit();
+    pushStepEdit(m_module, before, name);
+}
+
+void HardSeqsWidget::appendSongMenu(Menu *menu)
+{
+    std::vector<std::string> slot_labels;
+    for (int i = 1; i <= kSongSlots; ++i)
+        slot_labels.push_back("Slot " + std::to_string(i));
+
+    const auto &song = m_module->m_song_snapshot.front();
+
+    menu->addChild(createBoolMenuItem("Song mode", "",
+        [this] () { return m_module->m_song_snapshot.front().is_song_mode; },
+        [this] (bool val) { m_module->setSongMode(val); }));
+
+    menu->addChild(createSubmenuItem("Store current steps in", "",
+    [this, slot_labels] (Menu *sub_menu)
+    {
+        for (int i = 0; i < kSongSlots; ++i)
+            sub_menu->addChild(createMenuItem(slot_labels[i], "", [this, i] () { m_module->storeSongSlot(i); }));
+    }));
+
+    menu->addChild(createSubmenuItem("Load steps from", "",
+    [this, slot_labels] (Menu *sub_menu)
+    {
+        for (int i = 0; i < kSongSlots; ++i)
+            sub_menu->addChild(createMenuItem(slot_labels[i], "", [this, i] () { editSteps("load song slot", [this, i] () { m_module->loadSongSlot(i); }); }));
+    }));
+
+    menu->addChild(new MenuSeparator());
+
+    for (int i = 0; i < song.count; ++i) {
+        const auto &entry = song.entries[i];
+        const auto label = std::to_string(i + 1) + ": slot " + std::to_string(entry.slot + 1)
+            + " x" + std::to_string(entry.repeat)
+            + ", len " + std::to_string(entry.len)
+            + ", start " + std::to_string(entry.start + 1);
+
+        menu->addChild(createSubmenuItem(label, song.is_song_mode && song.pos == i ? "playing" : "",
+        [this, i] (Menu *sub_menu)
+        {
+            appendSongEntryMenu(sub_menu, i);
+        }));
+    }
+
+    menu->addChild(createMenuItem("Add entry", "",
+    [this] ()
+    {
+        m_module->addSongEntry();
+    }, song.count >= kSongEntries));
+}
+
+void HardSeqsWidget::appendSongEntryMenu(Menu *menu, int index)
+{
+    std::vector<std::string> slot_labels, count_labels, step_labels;
+    for (int i = 1; i <= kSongSlots; ++i)
+        slot_labels.push_back("Slot " + std::to_string(i));
+    for (int i = 1; i <= kSongMaxRepeat; ++i)
+        count_labels.push_back(std::to_string(i));
+    for (int i = 1; i <= kLenSteps; ++i)
+        step_labels.push_back(std::to_string(i));
+
+    // the menu edits what the audio thread last published
+    auto entry_at = [this, index] () { return m_module->m_song_snapshot.front().entries[index]; };
+
+    menu->addChild(createIndexSubmenuItem("Pattern", slot_labels,
+        [entry_at] () { return static_cast<size_t>(entry_at().slot); },
+        [this, index, entry_at] (size_t val) { auto entry = entry_at(); entry.slot = static_cast<uint8_t>(val); m_module->setSongEntry(index, entry); }));
+
+    menu->addChild(createIndexSubmenuItem("Repeat", count_labels,
+        [entry_at] () { return static_cast<size_t>(entry_at().repeat - 1); },
+        [this, index, entry_at] (size_t val) { auto entry = entry_at(); entry.repeat = static_cast<uint8_t>(val + 1); m_module->setSongEntry(index, entry); }));
+
+    menu->addChild(createIndexSubmenuItem("Length", step_labels,
+        [entry_at] () { return static_cast<size_t>(entry_at().len - 1); },
+        [this, index, entry_at] (size_t val) { auto entry = entry_at(); entry.len = static_cast<uint8_t>(val + 1); m_module->setSongEntry(index, entry); }));
+
+    menu->addChild(createIndexSubmenuItem("Start position", step_labels,
+        [entry_at] () { return static_cast<size_t>(entry_at().start); },
+        [this, index, entry_at] (size_t val) { auto entry = entry_at(); entry.start = static_cast<uint8_t>(val); m_module->setSongEntry(index, entry); }));
+
+    menu->addChild(createMenuItem("Remove", "",
+    [this, index] ()
+    {
+        m_module->removeSongEntry(index);
     }));
 }
 
@@ -0,0 +1,58 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Fixed-size binary form of one step table. Used wherever steps leave the module as raw
+// bytes (pattern library files, pattern bank), fields are stored little-endian.
+
+constexpr const int kPackedSteps = 16;
+constexpr const int kPackedLanes = 8;
+
+// PackedStep::flags
+constexpr const uint8_t kPackedGate = 1u << 0;
+constexpr const uint8_t kPackedEachShift = 1;
+constexpr const uint8_t kPackedGlide = 1u << 6;
+// PackedStep::len_each_n
+constexpr const uint8_t kPackedElenMask = 0x07;
+constexpr const uint8_t kPackedCondShift = 3;
+// PackedStep::cycle, A - 1 in the low nibble, B - 1 in the high one
+constexpr const uint8_t kPackedCycleMask = 0x0f;
+constexpr const uint8_t kPackedCycleShift = 4;
+
+struct PackedStep
+{
+    uint8_t flags;          // gate bit, then each_n[0..4], glide bit
+    uint8_t len_each_n;     // ELEN in bits 0..2, trig condition above
+    uint8_t prob;
+    uint8_t extra_ticks;    // step duration - 1
+    uint8_t cycle;          // A:B of the cycle trig condition
+    uint8_t reserved[3];
+    float values[kPackedLanes];     // value lanes: mod1..3, accent, lanes 5..8
+};
+
+struct PackedPattern
+{
+    PackedStep steps[kPackedSteps];
+};
+
+static_assert(sizeof(PackedStep) == 40, "PackedStep layout is part of the file format");
+static_assert(sizeof(PackedPattern) == 640, "PackedPattern layout is part of the file format");
@@ -0,0 +1,227 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#include "PatternGenerator.hpp"
+#include "PatternTables.hpp"
+
+#include <rack.hpp>
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+using namespace rack;
+
+constexpr const unsigned kMaxWorkers = 8;
+// Candidates below this count are not worth a thread
+constexpr const uint32_t kMinRangePerWorker = 1024;
+// Steps 2, 4, 6... in 1-based counting
+constexpr const int32_t kOffbeatMask = 0xAAAA;
+
+// Worker threads shared by every HardSeqs instance, they sleep between searches
+class WorkerPool
+{
+public:
+    static WorkerPool& shared()
+    {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_stopping = true;
+        }
+        m_wake.notify_all();
+
+        for (auto &it : m_threads)
+            it.join();
+    }
+
+    unsigned size() const { return m_size; }
+
+    void post(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_threads.empty()) {
+                for (unsigned i = 0; i < m_size; ++i)
+                    m_threads.emplace_back([this] () { run(); });
+            }
+
+            m_tasks.push_back(std::move(task));
+        }
+        m_wake.notify_one();
+    }
+
+private:
+    WorkerPool() : m_size(std::max(1u, std::min(kMaxWorkers, std::thread::hardware_concurrency()))) {}
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while (true) {
+            m_wake.wait(lock, [this] () { return m_is_stopping || !m_tasks.empty(); });
+            if (m_is_stopping)
+                return;
+
+            auto task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    const unsigned m_size;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::function<void()>> m_tasks;
+    std::vector<std::thread> m_threads;
+    bool m_is_stopping = false;
+};
+
+// Gates in the low 16 bits of every lane
+static simd::int32_4 popcount16(simd::int32_4 x)
+{
+    x = x - ((x >> 1) & simd::int32_4(0x5555));
+    x = (x & simd::int32_4(0x3333)) + ((x >> 2) & simd::int32_4(0x3333));
+    x = (x + (x >> 4)) & simd::int32_4(0x0F0F);
+    return (x + (x >> 8)) & simd::int32_4(0x1F);
+}
+
+// Cheap integer hash so that ties are broken differently for every seed
+static uint32_t tieKey(uint32_t mask, uint32_t seed)
+{
+    uint32_t h = (mask + 1) * 0x9E3779B1u ^ seed;
+    h ^= h >> 15;
+    h *= 0x85EBCA77u;
+    h ^= h >> 13;
+
+    return h;
+}
+
+static bool isBetter(float score, uint32_t tie_key, float best_score, uint32_t best_tie_key)
+{
+    return score < best_score || (score == best_score && tie_key < best_tie_key);
+}
+
+PatternGenerator::Candidate PatternGenerator::searchRange(const PatternConstraints &c, uint32_t from, uint32_t to)
+{
+    const simd::float_4 inv_len = 1.0f / c.len;
+    const int32_t len_mask = (1 << c.len) - 1;
+    const simd::int32_4 avoid = c.avoid_mask & len_mask;
+    const simd::int32_4 current = c.current_mask & len_mask;
+    const simd::float_4 density = static_cast<float>(c.density);
+    const simd::float_4 syncopation = c.syncopation;
+    const simd::float_4 last = static_cast<float>(to - 1);
+
+    std::array<simd::int32_4, 16> euclid_rotations {};
+    const uint16_t euclid = PatternTables::euclid(std::max(0, std::min(c.density, c.len)), c.len);
+    for (int r = 0; r < c.len; ++r)
+        euclid_rotations[r] = PatternTables::rotateMask(euclid, r, c.len);
+
+    Candidate best {std::numeric_limits<float>::max(), 0, 0};
+
+    // four candidates per pass, lanes past the range score as the worst possible
+    for (uint32_t base = from; base < to; base += 4) {
+        const simd::int32_4 masks = simd::int32_4(static_cast<int32_t>(base)) + simd::int32_4(0, 1, 2, 3);
+
+        const simd::float_4 hits = simd::float_4(popcount16(masks));
+        const simd::float_4 inv_hits = 1.0f / simd::fmax(hits, 1.0f);
+
+        const simd::float_4 density_err = simd::fabs(hits - density) * inv_len;
+        const simd::float_4 sync_err = simd::float_4(popcount16(masks & simd::int32_4(kOffbeatMask))) * inv_hits - syncopation;
+
+        simd::float_4 euclid_dist = static_cast<float>(c.len);
+        if (c.w_euclid != 0.0f) {
+            for (int r = 0; r < c.len; ++r)
+                euclid_dist = simd::fmin(euclid_dist, simd::float_4(popcount16(masks ^ euclid_rotations[r])));
+        }
+
+        simd::float_4 score = c.w_density * density_err
+            + c.w_syncopation * sync_err * sync_err
+            + c.w_euclid * euclid_dist * inv_len
+            + c.w_similarity * simd::float_4(popcount16(masks ^ current)) * inv_len
+            + c.w_collision * simd::float_4(popcount16(masks & avoid)) * inv_hits;
+
+        score = simd::ifelse(simd::float_4(masks) <= last, score, std::numeric_limits<float>::max());
+
+        const int is_candidate = simd::movemask(score <= best.score);
+        if (is_candidate == 0)
+            continue;
+
+        for (int i = 0; i < 4; ++i) {
+            const uint32_t mask = base + i;
+            const uint32_t tie_key = tieKey(mask, c.seed);
+
+            if (((is_candidate >> i) & 1) && isBetter(score[i], tie_key, best.score, best.tie_key))
+                best = {score[i], tie_key, static_cast<uint16_t>(mask)};
+        }
+    }
+
+    return best;
+}
+
+void PatternGenerator::finishRange(const std::shared_ptr<Job> &job, unsigned range, uint32_t from, uint32_t to)
+{
+    job->results[range] = searchRange(job->constraints, from, to);
+
+    // the last range to finish picks the best of all
+    if (job->ranges_left.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    const auto best = std::min_element(job->results.begin(), job->results.end(),
+        [] (const Candidate &a, const Candidate &b) { return isBetter(a.score, a.tie_key, b.score, b.tie_key); });
+
+    job->mask = best->mask;
+    job->is_done.store(true, std::memory_order_release);
+}
+
+std::shared_ptr<PatternGenerator::Job> PatternGenerator::start(const PatternConstraints &constraints)
+{
+    auto job = std::make_shared<Job>();
+    job->constraints = constraints;
+    job->constraints.len = std::max(1, std::min(constraints.len, 16));
+
+    auto &pool = WorkerPool::shared();
+    const uint32_t total = 1u << job->constraints.len;
+    const unsigned ranges = std::max(1u, std::min(pool.size(), total / kMinRangePerWorker));
+
+    job->results.resize(ranges);
+    job->ranges_left.store(static_cast<int>(ranges));
+
+    const uint32_t chunk = total / ranges;
+    for (unsigned i = 0; i < ranges; ++i) {
+        const uint32_t from = i * chunk;
+        const uint32_t to = (i + 1 == ranges) ? total : from + chunk;
+        pool.post([job, i, from, to] () { finishRange(job, i, from, to); });
+    }
+
+    return job;
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// What the generated gate mask should look like. Every weight set to 0 disables the
+// corresponding term of the score.
+struct PatternConstraints
+{
+    int len = 16;               // only the first len steps may receive gates
+    int density = 4;            // wanted amount of gates
+    float syncopation = 0.0;    // wanted share of gates on off-beats, 0..1
+    float w_density = 1.0;      // distance to density, relative to len
+    float w_syncopation = 0.0;
+    float w_euclid = 0.0;       // distance to the closest rotation of euclid(density, len)
+    float w_similarity = 0.0;   // distance to current_mask
+    float w_collision = 0.0;    // gates shared with avoid_mask
+    uint16_t current_mask = 0;
+    uint16_t avoid_mask = 0;
+    uint32_t seed = 0;          // breaks ties between equally scored candidates
+};
+
+class PatternGenerator
+{
+private:
+    struct Candidate {
+        float score;
+        uint32_t tie_key;
+        uint16_t mask;
+    };
+
+public:
+    // One search on the shared worker pool. The caller polls is_done, mask is valid after it.
+    struct Job {
+        PatternConstraints constraints;
+        std::vector<Candidate> results;
+        std::atomic<int> ranges_left {0};
+        std::atomic<bool> is_done {false};
+        uint16_t mask = 0;
+    };
+
+    // Queues a search over every gate mask of c.len steps and returns at once. The search
+    // space is split between persistent worker threads, started with the first search.
+    static std::shared_ptr<Job> start(const PatternConstraints &c);
+
+private:
+    static Candidate searchRange(const PatternConstraints &c, uint32_t from, uint32_t to);
+    static void finishRange(const std::shared_ptr<Job> &job, unsigned range, uint32_t from, uint32_t to);
+};
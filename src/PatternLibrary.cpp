@@ -0,0 +1,379 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#include "PatternLibrary.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#ifdef ARCH_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static std::size_t indexOffset(PatternLibrary::Index index, uint32_t count)
+{
+    return sizeof(LibraryHeader) + static_cast<std::size_t>(index) * count * sizeof(uint32_t);
+}
+
+// Version 1 step: three mod lanes only
+struct PackedStepV1
+{
+    uint8_t flags;
+    uint8_t len_each_n;
+    uint8_t prob;
+    uint8_t extra_ticks;
+    float mods[3];
+};
+
+// Version 2 step: all value lanes, no cycle condition
+struct PackedStepV2
+{
+    uint8_t flags;
+    uint8_t len_each_n;
+    uint8_t prob;
+    uint8_t extra_ticks;
+    float values[kPackedLanes];
+};
+
+template <typename Step>
+struct LibraryRecordOld
+{
+    char name[kLibraryNameLen];
+    char tag[kLibraryTagLen];
+    uint8_t density;
+    uint8_t reserved[15];
+    Step steps[kPackedSteps];
+};
+
+static_assert(sizeof(LibraryRecordOld<PackedStepV1>) == 320, "version 1 file layout");
+static_assert(sizeof(LibraryRecordOld<PackedStepV2>) == 640, "version 2 file layout");
+
+static void convertStep(const PackedStepV1 &old_step, PackedStep &step)
+{
+    for (int lane = 0; lane < 3; ++lane)
+        step.values[lane] = old_step.mods[lane];
+}
+
+static void convertStep(const PackedStepV2 &old_step, PackedStep &step)
+{
+    for (int lane = 0; lane < kPackedLanes; ++lane)
+        step.values[lane] = old_step.values[lane];
+}
+
+// Same header and indices, records widened to the current layout. Fields a version lacks stay 0.
+template <typename Step>
+static bool convertRecords(const uint8_t *data, std::size_t size, std::vector<uint8_t> &converted)
+{
+    const auto *header = reinterpret_cast<const LibraryHeader*>(data);
+    if (header->records_offset != indexOffset(PatternLibrary::INDEX_COUNT, header->count)
+            || size < header->records_offset + static_cast<std::size_t>(header->count) * sizeof(LibraryRecordOld<Step>))
+        return false;
+
+    converted.assign(header->records_offset + static_cast<std::size_t>(header->count) * sizeof(LibraryRecord), 0);
+    std::memcpy(converted.data(), data, header->records_offset);
+    reinterpret_cast<LibraryHeader*>(converted.data())->version = kLibraryVersion;
+
+    const auto *old_records = reinterpret_cast<const LibraryRecordOld<Step>*>(data + header->records_offset);
+    auto *records = reinterpret_cast<LibraryRecord*>(converted.data() + header->records_offset);
+
+    for (uint32_t i = 0; i < header->count; ++i) {
+        const auto &old_record = old_records[i];
+        auto &record = records[i];
+
+        std::memcpy(record.name, old_record.name, kLibraryNameLen);
+        std::memcpy(record.tag, old_record.tag, kLibraryTagLen);
+        record.density = old_record.density;
+
+        for (int s = 0; s < kPackedSteps; ++s) {
+            const auto &old_step = old_record.steps[s];
+            auto &step = record.pattern.steps[s];
+
+            step.flags = old_step.flags;
+            step.len_each_n = old_step.len_each_n;
+            step.prob = old_step.prob;
+            step.extra_ticks = old_step.extra_ticks;
+            convertStep(old_step, step);
+        }
+    }
+
+    return true;
+}
+
+static bool writeLibrary(const std::string &path, const std::vector<LibraryRecord> &records)
+{
+    const uint32_t count = static_cast<uint32_t>(records.size());
+
+    std::vector<uint32_t> by_name(count), by_tag(count), by_density(count);
+    std::iota(by_name.begin(), by_name.end(), 0);
+    std::iota(by_tag.begin(), by_tag.end(), 0);
+    std::iota(by_density.begin(), by_density.end(), 0);
+
+    std::stable_sort(by_name.begin(), by_name.end(), [&records] (uint32_t a, uint32_t b) {
+        return strncmp(records[a].name, records[b].name, kLibraryNameLen) < 0;
+    });
+    // name is the secondary key of both other indices
+    by_tag = by_name;
+    by_density = by_name;
+    std::stable_sort(by_tag.begin(), by_tag.end(), [&records] (uint32_t a, uint32_t b) {
+        return strncmp(records[a].tag, records[b].tag, kLibraryTagLen) < 0;
+    });
+    std::stable_sort(by_density.begin(), by_density.end(), [&records] (uint32_t a, uint32_t b) {
+        return records[a].density < records[b].density;
+    });
+
+    LibraryHeader header;
+    std::memcpy(header.magic, kLibraryMagic, sizeof(header.magic));
+    header.version = kLibraryVersion;
+    header.count = count;
+    header.records_offset = static_cast<uint32_t>(indexOffset(PatternLibrary::INDEX_COUNT, count));
+
+    // write next to the target and swap, so a failed write never destroys the library
+    const std::string tmp_path = path + ".tmp";
+    FILE *file = std::fopen(tmp_path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    bool is_ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const auto *index : {&by_name, &by_tag, &by_density})
+        is_ok = is_ok && std::fwrite(index->data(), sizeof(uint32_t), count, file) == count;
+    is_ok = is_ok && std::fwrite(records.data(), sizeof(LibraryRecord), count, file) == count;
+    is_ok = std::fclose(file) == 0 && is_ok;
+
+    if (!is_ok) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    std::remove(path.c_str());
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+PatternLibrary& PatternLibrary::shared()
+{
+    static PatternLibrary library;
+    return library;
+}
+
+PatternLibrary::~PatternLibrary()
+{
+    unmap();
+}
+
+bool PatternLibrary::open(const std::string &path)
+{
+    close();
+
+    if (!map(path))
+        return false;
+
+    const auto *header = reinterpret_cast<const LibraryHeader*>(m_data);
+    if (m_data_size >= sizeof(LibraryHeader) && (header->version == 1 || header->version == 2)
+            && std::memcmp(header->magic, kLibraryMagic, sizeof(header->magic)) == 0) {
+        std::vector<uint8_t> converted;
+        const bool is_converted = header->version == 1
+            ? convertRecords<PackedStepV1>(m_data, m_data_size, converted)
+            : convertRecords<PackedStepV2>(m_data, m_data_size, converted);
+        unmap();
+        if (!is_converted)
+            return false;
+
+        m_converted = std::move(converted);
+        m_data = m_converted.data();
+        m_data_size = m_converted.size();
+        header = reinterpret_cast<const LibraryHeader*>(m_data);
+    } else if (m_data_size >= sizeof(LibraryHeader) && header->version != kLibraryVersion) {
+        std::fprintf(stderr, "hardseqs library: %s is version %u, this build reads up to version %u\n",
+            path.c_str(), static_cast<unsigned>(header->version), static_cast<unsigned>(kLibraryVersion));
+    }
+
+    const bool is_valid = m_data_size >= sizeof(LibraryHeader)
+        && std::memcmp(header->magic, kLibraryMagic, sizeof(header->magic)) == 0
+        && header->version == kLibraryVersion
+        && header->records_offset == indexOffset(INDEX_COUNT, header->count)
+        && m_data_size >= header->records_offset + static_cast<std::size_t>(header->count) * sizeof(LibraryRecord);
+
+    if (!is_valid) {
+        unmap();
+        return false;
+    }
+
+    const auto *indices = reinterpret_cast<const uint32_t*>(m_data + sizeof(LibraryHeader));
+    for (std::size_t i = 0; i < static_cast<std::size_t>(INDEX_COUNT) * header->count; ++i) {
+        if (indices[i] >= header->count) {
+            unmap();
+            return false;
+        }
+    }
+
+    m_path = path;
+    return true;
+}
+
+void PatternLibrary::close()
+{
+    unmap();
+    m_path.clear();
+}
+
+bool PatternLibrary::create(const std::string &path)
+{
+    close();
+
+    if (!writeLibrary(path, {}))
+        return false;
+
+    return open(path);
+}
+
+bool PatternLibrary::append(const std::string &name, const std::string &tag, const PackedPattern &pattern)
+{
+    if (!isOpen())
+        return false;
+
+    std::vector<LibraryRecord> records(size());
+    if (!records.empty())
+        std::memcpy(records.data(), m_data + reinterpret_cast<const LibraryHeader*>(m_data)->records_offset, records.size() * sizeof(LibraryRecord));
+
+    LibraryRecord record;
+    std::memset(&record, 0, sizeof(record));
+    std::strncpy(record.name, name.c_str(), kLibraryNameLen - 1);
+    std::strncpy(record.tag, tag.c_str(), kLibraryTagLen - 1);
+    record.pattern = pattern;
+
+    for (const auto &it : pattern.steps)
+        record.density += (it.flags & kPackedGate) ? 1 : 0;
+
+    records.push_back(record);
+
+    // the mapping has to go before the file is replaced
+    const std::string path = m_path;
+    close();
+
+    const bool is_written = writeLibrary(path, records);
+    return open(path) && is_written;
+}
+
+uint32_t PatternLibrary::size() const
+{
+    return isOpen() ? reinterpret_cast<const LibraryHeader*>(m_data)->count : 0;
+}
+
+const LibraryRecord& PatternLibrary::record(Index index, uint32_t n) const
+{
+    const auto *header = reinterpret_cast<const LibraryHeader*>(m_data);
+    const auto *indices = reinterpret_cast<const uint32_t*>(m_data + indexOffset(index, header->count));
+    const auto *records = reinterpret_cast<const LibraryRecord*>(m_data + header->records_offset);
+
+    return records[indices[n]];
+}
+
+#ifdef ARCH_WIN
+
+bool PatternLibrary::map(const std::string &path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_data_size = static_cast<std::size_t>(file_size.QuadPart);
+    m_file_handle = file;
+    m_mapping_handle = mapping;
+    return true;
+}
+
+void PatternLibrary::unmap()
+{
+    if (m_data && m_converted.empty())
+        UnmapViewOfFile(m_data);
+    if (m_mapping_handle)
+        CloseHandle(m_mapping_handle);
+    if (m_file_handle)
+        CloseHandle(m_file_handle);
+
+    m_data = nullptr;
+    m_data_size = 0;
+    m_converted.clear();
+    m_mapping_handle = nullptr;
+    m_file_handle = nullptr;
+}
+
+#else
+
+bool PatternLibrary::map(const std::string &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    m_data = static_cast<const uint8_t*>(data);
+    m_data_size = static_cast<std::size_t>(st.st_size);
+    return true;
+}
+
+void PatternLibrary::unmap()
+{
+    if (m_data && m_converted.empty())
+        munmap(const_cast<uint8_t*>(m_data), m_data_size);
+
+    m_data = nullptr;
+    m_data_size = 0;
+    m_converted.clear();
+}
+
+#endif
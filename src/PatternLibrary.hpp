@@ -0,0 +1,111 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PackedPattern.hpp"
+
+// Pattern library file (.hspl):
+//   LibraryHeader
+//   uint32_t by_name[count], by_tag[count], by_density[count]   record numbers in key order
+//   LibraryRecord records[count]
+// The file is memory-mapped read-only, so browsing never parses anything.
+
+constexpr const char kLibraryMagic[4] = {'H', 'S', 'P', 'L'};
+// 2: steps carry all 8 value lanes
+// 3: steps carry the A:B of the cycle trig condition
+// Older files are converted in memory when opened and written back as the current version
+// by the next append()
+constexpr const uint32_t kLibraryVersion = 3;
+constexpr const int kLibraryNameLen = 32;
+constexpr const int kLibraryTagLen = 16;
+
+struct LibraryHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t records_offset;
+};
+
+struct LibraryRecord
+{
+    char name[kLibraryNameLen];
+    char tag[kLibraryTagLen];
+    uint8_t density;
+    uint8_t reserved[15];
+    PackedPattern pattern;
+};
+
+static_assert(sizeof(LibraryHeader) == 16, "LibraryHeader layout is part of the file format");
+static_assert(sizeof(LibraryRecord) == 704, "LibraryRecord layout is part of the file format");
+
+class PatternLibrary
+{
+public:
+    enum Index {
+        INDEX_NAME,
+        INDEX_TAG,
+        INDEX_DENSITY,
+
+        INDEX_COUNT
+    };
+
+    // One library is open per plugin, shared by every HardSeqs instance
+    static PatternLibrary& shared();
+
+    ~PatternLibrary();
+
+    bool open(const std::string &path);
+    void close();
+    // Writes an empty library and opens it
+    bool create(const std::string &path);
+    // Rewrites the file with the new record and a rebuilt index, then maps it again
+    bool append(const std::string &name, const std::string &tag, const PackedPattern &pattern);
+
+    bool isOpen() const { return m_data != nullptr; }
+    const std::string& path() const { return m_path; }
+    uint32_t size() const;
+
+    // n-th record in the order of the given index
+    const LibraryRecord& record(Index index, uint32_t n) const;
+
+private:
+    PatternLibrary() = default;
+    PatternLibrary(const PatternLibrary&) = delete;
+    PatternLibrary& operator=(const PatternLibrary&) = delete;
+
+    bool map(const std::string &path);
+    void unmap();
+
+    std::string m_path;
+    const uint8_t *m_data = nullptr;
+    std::size_t m_data_size = 0;
+    // an older file converted to the current layout, m_data points here instead of at a mapping
+    std::vector<uint8_t> m_converted;
+
+    #ifdef ARCH_WIN
+    void *m_file_handle = nullptr;
+    void *m_mapping_handle = nullptr;
+    #endif
+};
@@ -0,0 +1,149 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#include "PatternLinks.hpp"
+
+#include <algorithm>
+
+PatternLinks& PatternLinks::shared()
+{
+    static PatternLinks links;
+    return links;
+}
+
+const SharedPattern* PatternLinks::current(int group) const
+{
+    // sequentially consistent with the acknowledgements, see HardSeqs::applyLinkedSteps()
+    return m_groups[group].current.load();
+}
+
+uint64_t PatternLinks::publish(int group_id, const PackedPattern &pattern)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &group = m_groups[group_id];
+
+    std::unique_ptr<SharedPattern> shared_pattern(new SharedPattern);
+    shared_pattern->pattern = pattern;
+    HardSeqs::unpackStepArray(pattern, shared_pattern->steps);
+    shared_pattern->version = ++m_last_version;
+
+    group.current.store(shared_pattern.get());
+    group.versions.push_back(std::move(shared_pattern));
+
+    collect(group);
+
+    return m_last_version;
+}
+
+bool PatternLinks::snapshot(int group_id, PackedPattern &pattern)
+{
+    // versions are only freed by collect() under the same lock
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto *shared_pattern = m_groups[group_id].current.load(std::memory_order_acquire);
+    if (!shared_pattern)
+        return false;
+
+    pattern = shared_pattern->pattern;
+    return true;
+}
+
+bool PatternLinks::snapshot(int group_id, HardSeqs::StepTable &steps, uint64_t &version)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto *shared_pattern = m_groups[group_id].current.load(std::memory_order_acquire);
+    if (!shared_pattern || shared_pattern->version == version)
+        return false;
+
+    steps = shared_pattern->steps;
+    version = shared_pattern->version;
+    return true;
+}
+
+bool PatternLinks::attach(int group_id, const std::atomic<uint64_t> *acked_version)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &group = m_groups[group_id];
+
+    bool has_members = false;
+    bool is_registered = false;
+
+    for (auto &it : group.members) {
+        if (it.acked_version == acked_version) {
+            it.is_leaving = false;
+            is_registered = true;
+        } else {
+            has_members = has_members || !it.is_leaving;
+        }
+    }
+
+    if (!is_registered)
+        group.members.push_back(Member {acked_version, false});
+
+    return has_members;
+}
+
+void PatternLinks::detach(int group_id, const std::atomic<uint64_t> *acked_version)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &group = m_groups[group_id];
+
+    // the leaving member's audio thread may still be playing a version of the group
+    for (auto &it : group.members) {
+        if (it.acked_version == acked_version)
+            it.is_leaving = true;
+    }
+
+    collect(group);
+}
+
+void PatternLinks::remove(const std::atomic<uint64_t> *acked_version)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto &group : m_groups) {
+        group.members.erase(std::remove_if(group.members.begin(), group.members.end(),
+            [acked_version] (const Member &it) { return it.acked_version == acked_version; }),
+            group.members.end());
+
+        collect(group);
+    }
+}
+
+void PatternLinks::collect(Group &group)
+{
+    // A member may read its acknowledged version and anything newer, but nothing older.
+    // 0 holds every version while a member switches to another one.
+    uint64_t min_acked = kLinkReleased;
+    for (const auto &it : group.members)
+        min_acked = std::min(min_acked, it.acked_version->load());
+
+    group.members.erase(std::remove_if(group.members.begin(), group.members.end(),
+        [] (const Member &it) { return it.is_leaving && it.acked_version->load() == kLinkReleased; }),
+        group.members.end());
+
+    if (group.versions.empty())
+        return;
+
+    // the current version always stays
+    group.versions.erase(std::remove_if(group.versions.begin(), group.versions.end() - 1,
+        [min_acked] (const std::unique_ptr<SharedPattern> &it) { return it->version < min_acked; }),
+        group.versions.end() - 1);
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "HardSeqs.hpp"
+#include "PackedPattern.hpp"
+
+constexpr const int kLinkGroups = 8;
+// Acknowledged by a member whose audio thread no longer reads any version
+constexpr const uint64_t kLinkReleased = UINT64_MAX;
+
+// One immutable version of a linked group's steps, packed for copies leaving the module and
+// unpacked for the members' audio threads, which play it in place. Never modified after publish.
+struct SharedPattern
+{
+    PackedPattern pattern;
+    HardSeqs::StepTable steps;
+    uint64_t version;
+};
+
+// Copy-on-write step tables shared by linked HardSeqs instances. Every member plays the current
+// version without copying it, an edit publishes a new version from the editor's own copy.
+// Versions are numbered across all groups, and each member acknowledges the one its audio
+// thread reads. Older versions are freed once no member, leaving ones included, acknowledges
+// them any more, so members read current() from the audio thread without taking a lock.
+class PatternLinks
+{
+public:
+    static PatternLinks& shared();
+
+    // Lock-free, nullptr until something was published to the group
+    const SharedPattern* current(int group) const;
+
+    // Everything below takes the registry lock, do not call from process()
+    uint64_t publish(int group, const PackedPattern &pattern);
+    // Copies the current version for threads that are not group members, false if empty
+    bool snapshot(int group, PackedPattern &pattern);
+    // Copies the current steps if they are newer than version, false if nothing was copied
+    bool snapshot(int group, HardSeqs::StepTable &steps, uint64_t &version);
+    // Returns true when the group already has members whose pattern should be adopted
+    bool attach(int group, const std::atomic<uint64_t> *acked_version);
+    // The member stays registered as leaving until its audio thread acknowledges kLinkReleased
+    void detach(int group, const std::atomic<uint64_t> *acked_version);
+    // Drops the member from every group, only once its audio thread no longer runs
+    void remove(const std::atomic<uint64_t> *acked_version);
+
+private:
+    struct Member {
+        const std::atomic<uint64_t> *acked_version;
+        bool is_leaving;
+    };
+
+    struct Group {
+        std::atomic<const SharedPattern*> current {nullptr};
+        std::vector<std::unique_ptr<SharedPattern>> versions;
+        std::vector<Member> members;
+    };
+
+    PatternLinks() = default;
+    void collect(Group &group);
+
+    std::mutex m_mutex;
+    std::array<Group, kLinkGroups> m_groups;
+    uint64_t m_last_version = 0;
+};
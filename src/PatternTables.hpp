@@ -0,0 +1,108 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Compile-time lookup tables for the algorithmic gate modes. Every table is indexed by
+// (k, n) with k, n in 0..16, so the audio thread only does a load per clock edge.
+
+namespace PatternTables {
+
+constexpr const int kDim = 17;
+constexpr const int kMarkovBias = 16;
+
+template<int... Is> struct IndexList {};
+template<int N, int... Is> struct MakeIndexList : MakeIndexList<N - 1, N - 1, Is...> {};
+template<int... Is> struct MakeIndexList<0, Is...> { typedef IndexList<Is...> type; };
+
+template<typename T, T (*F)(int), typename L> struct Lut;
+template<typename T, T (*F)(int), int... Is> struct Lut<T, F, IndexList<Is...>>
+{
+    static constexpr T table[sizeof...(Is)] = { F(Is)... };
+};
+template<typename T, T (*F)(int), int... Is>
+constexpr T Lut<T, F, IndexList<Is...>>::table[sizeof...(Is)];
+
+constexpr uint16_t rotateMask(uint16_t mask, int rot, int len)
+{
+    return len == 0 || rot % len == 0 ? mask
+        : static_cast<uint16_t>(((mask << (rot % len)) | (mask >> (len - rot % len))) & ((1u << len) - 1));
+}
+
+// Bresenham form of the euclidean rhythm, first step always set
+constexpr uint16_t euclidBits(int k, int n, int i)
+{
+    return i >= n ? 0 : static_cast<uint16_t>((((i * k) % n < k ? 1u : 0u) << i) | euclidBits(k, n, i + 1));
+}
+
+constexpr uint16_t euclidEntry(int idx)
+{
+    return idx % kDim == 0 ? 0 : euclidBits(idx / kDim > idx % kDim ? idx % kDim : idx / kDim, idx % kDim, 0);
+}
+
+// Density ramp fills steps in bit-reversed order (1, 9, 5, 13, ...), so raising k only
+// ever adds gates and strong beats come first
+constexpr int bitReverse4(int i)
+{
+    return ((i & 1) << 3) | ((i & 2) << 1) | ((i & 4) >> 1) | ((i & 8) >> 3);
+}
+
+constexpr uint16_t rampBits(int k, int n, int order)
+{
+    return k == 0 || order >= 16 ? 0
+        : bitReverse4(order) < n ? static_cast<uint16_t>((1u << bitReverse4(order)) | rampBits(k - 1, n, order + 1))
+        : rampBits(k, n, order + 1);
+}
+
+constexpr uint16_t rampEntry(int idx)
+{
+    return rampBits(idx / kDim, idx % kDim, 0);
+}
+
+// Two-state chain with stationary density k/16 and lag-1 correlation bias/16, stored as
+// percent chance of a gate for (k, bias, previous gate)
+constexpr uint8_t markovEntry(int idx)
+{
+    return static_cast<uint8_t>(idx % 2
+        ? (100 * ((idx / 32) * 16 + ((idx / 2) % 16) * (16 - idx / 32))) / 256
+        : (100 * (idx / 32) * (16 - (idx / 2) % 16)) / 256);
+}
+
+typedef Lut<uint16_t, euclidEntry, MakeIndexList<kDim * kDim>::type> EuclidLut;
+typedef Lut<uint16_t, rampEntry, MakeIndexList<kDim * kDim>::type> RampLut;
+typedef Lut<uint8_t, markovEntry, MakeIndexList<kDim * kMarkovBias * 2>::type> MarkovLut;
+
+inline uint16_t euclid(int k, int n)
+{
+    return EuclidLut::table[k * kDim + n];
+}
+
+inline uint16_t densityRamp(int k, int n)
+{
+    return RampLut::table[k * kDim + n];
+}
+
+inline int markovPercent(int k, int bias, bool prev_gate)
+{
+    return MarkovLut::table[(k * kMarkovBias + bias) * 2 + (prev_gate ? 1 : 0)];
+}
+
+} // namespace PatternTables
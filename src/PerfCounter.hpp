@@ -0,0 +1,77 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#ifdef ARCH_LIN
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware cache-miss counter of the thread that creates it, from Linux perf. read() is one
+// syscall, so read it per block of samples and never per sample. Without perf (other platforms,
+// kernel.perf_event_paranoid > 2) read() returns -1.
+class CacheMissCounter
+{
+public:
+    CacheMissCounter()
+    {
+        #ifdef ARCH_LIN
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        m_fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        #endif
+    }
+
+    ~CacheMissCounter()
+    {
+        #ifdef ARCH_LIN
+        if (m_fd >= 0)
+            close(m_fd);
+        #endif
+    }
+
+    CacheMissCounter(const CacheMissCounter&) = delete;
+    CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+    int64_t read() const
+    {
+        int64_t count = -1;
+
+        #ifdef ARCH_LIN
+        if (m_fd < 0 || ::read(m_fd, &count, sizeof(count)) != sizeof(count))
+            return -1;
+        #endif
+
+        return count;
+    }
+
+private:
+    int m_fd = -1;
+};
@@ -0,0 +1,192 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#include "Profiler.hpp"
+
+#ifdef HS_PROFILE
+
+#include "HardSeqs.hpp"
+#include "PerfCounter.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+// Block times go into log2 buckets of nanoseconds
+constexpr const int kProfileBuckets = 40;
+
+static std::atomic<int> g_instances {0};
+static std::atomic<int64_t> g_samples {0};
+static std::atomic<int64_t> g_ns {0};
+static std::atomic<int64_t> g_misses {0};
+static std::atomic<int64_t> g_max_block_ns {0};
+static std::atomic<int64_t> g_buckets[kProfileBuckets];
+static std::atomic<bool> g_has_misses {false};
+
+// Reporter thread, runs while at least one instance exists
+static std::mutex g_reporter_mutex;
+static std::condition_variable g_reporter_wake;
+static std::thread g_reporter;
+static bool g_is_reporter_stopping = false;
+
+static int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One counter per engine thread, opened on first use
+static int64_t readMisses()
+{
+    static thread_local CacheMissCounter counter;
+    return counter.read();
+}
+
+static int64_t bucketPercentile(const int64_t *buckets, int64_t total, double percentile)
+{
+    int64_t seen = 0;
+    for (int i = 0; i < kProfileBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= total * percentile)
+            return int64_t(1) << i;
+    }
+
+    return int64_t(1) << (kProfileBuckets - 1);
+}
+
+static void report(int64_t wall_ns)
+{
+    int64_t buckets[kProfileBuckets];
+    int64_t blocks = 0;
+    for (int i = 0; i < kProfileBuckets; ++i) {
+        buckets[i] = g_buckets[i].exchange(0);
+        blocks += buckets[i];
+    }
+
+    const int64_t samples = g_samples.exchange(0);
+    const int64_t ns = g_ns.exchange(0);
+    const int64_t misses = g_misses.exchange(0);
+    const int64_t max_block_ns = g_max_block_ns.exchange(0);
+
+    if (samples == 0 || blocks == 0)
+        return;
+
+    const double wall_seconds = wall_ns * 1e-9;
+
+    std::printf("hardseqs profile: %d instances, %d threads, %.1fM samples/s, %.0f ns/sample, "
+        "block p50 %lldus p99 %lldus max %lldus",
+        g_instances.load(), APP->engine->getNumThreads(), samples / wall_seconds * 1e-6, static_cast<double>(ns) / samples,
+        static_cast<long long>(bucketPercentile(buckets, blocks, 0.5) / 1000),
+        static_cast<long long>(bucketPercentile(buckets, blocks, 0.99) / 1000),
+        static_cast<long long>(max_block_ns / 1000));
+
+    if (g_has_misses.load())
+        std::printf(", %.2f cache misses/sample", static_cast<double>(misses) / samples);
+
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+static void runReporter()
+{
+    std::unique_lock<std::mutex> lock(g_reporter_mutex);
+    int64_t last_ns = nowNs();
+
+    while (!g_reporter_wake.wait_for(lock, std::chrono::duration<double>(kProfileReportSeconds),
+        [] () { return g_is_reporter_stopping; })) {
+        const int64_t now_ns = nowNs();
+
+        lock.unlock();
+        report(now_ns - last_ns);
+        lock.lock();
+
+        last_ns = now_ns;
+    }
+}
+
+ProcessProfile::ProcessProfile()
+{
+    std::lock_guard<std::mutex> lock(g_reporter_mutex);
+
+    if (g_instances++ == 0) {
+        g_is_reporter_stopping = false;
+        g_reporter = std::thread(runReporter);
+    }
+}
+
+ProcessProfile::~ProcessProfile()
+{
+    std::thread reporter;
+
+    {
+        std::lock_guard<std::mutex> lock(g_reporter_mutex);
+
+        if (--g_instances == 0) {
+            g_is_reporter_stopping = true;
+            reporter = std::move(g_reporter);
+        }
+    }
+
+    g_reporter_wake.notify_all();
+
+    if (reporter.joinable())
+        reporter.join();
+}
+
+void ProcessProfile::begin()
+{
+    // counters are read once per block, a read is a syscall
+    if (block_samples == 0)
+        block_misses = readMisses();
+
+    start_ns = nowNs();
+}
+
+void ProcessProfile::end()
+{
+    block_ns += nowNs() - start_ns;
+
+    if (++block_samples < kProfileBlockLen)
+        return;
+
+    const int64_t end_misses = readMisses();
+
+    int bucket = 0;
+    while (bucket < kProfileBuckets - 1 && (int64_t(1) << (bucket + 1)) <= block_ns)
+        bucket++;
+
+    g_buckets[bucket]++;
+    g_samples += block_samples;
+    g_ns += block_ns;
+
+    if (block_misses >= 0 && end_misses >= 0) {
+        g_misses += end_misses - block_misses;
+        g_has_misses = true;
+    }
+
+    int64_t max_ns = g_max_block_ns.load();
+    while (block_ns > max_ns && !g_max_block_ns.compare_exchange_weak(max_ns, block_ns)) {}
+
+    block_samples = 0;
+    block_ns = 0;
+}
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+// Build with -DHS_PROFILE (see Makefile) to measure how process() cost scales with the
+// number of HardSeqs instances and Rack engine threads in a running patch. Every instance
+// times its own process() calls in blocks of kProfileBlockLen samples and all instances feed
+// one shared histogram. A reporter thread prints a summary every kProfileReportSeconds, the
+// audio threads only update counters:
+//
+//   hardseqs profile: 128 instances, 4 threads, 6.1M samples/s, 92 ns/sample,
+//                     block p50 21us p99 48us max 130us, 0.8 cache misses/sample
+//
+// Cache misses come from Linux perf counters (PerfCounter.hpp) and are omitted where they are
+// unavailable. They are read at the first and last sample of a block, so they include whatever
+// else the engine thread ran in between. host/ has the headless scaling harness (hs_scale) and
+// the single module benchmark (hs_bench).
+
+#ifdef HS_PROFILE
+
+#include <cstdint>
+
+constexpr const int kProfileBlockLen = 256;
+constexpr const double kProfileReportSeconds = 5.0;
+
+struct ProcessProfile
+{
+    ProcessProfile();
+    ~ProcessProfile();
+
+    void begin();
+    void end();
+
+    int block_samples = 0;
+    int64_t block_ns = 0;
+    int64_t block_misses = -1;
+    int64_t start_ns = 0;
+};
+
+struct ProfileScope
+{
+    explicit ProfileScope(ProcessProfile &profile) : m_profile(profile) { m_profile.begin(); }
+    ~ProfileScope() { m_profile.end(); }
+
+    ProcessProfile &m_profile;
+};
+
+#endif
@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <random>
 
@@ -39,6 +42,35 @@ public:
         return randomValue < percent ? 1 : 0;
     }
 
+    // Percent rolls 0..99 for a batch of N entries. 16-bit chunks of each draw are
+    // scaled to 0..99, so 16 rolls cost 8 engine calls.
+    template<std::size_t N>
+    void randomPercentRolls(std::array<uint8_t, N> &rolls) {
+        uint32_t bits = 0;
+
+        for (std::size_t i = 0; i < N; ++i) {
+            if (i % 2 == 0)
+                bits = static_cast<uint32_t>(engine());
+
+            rolls[i] = static_cast<uint8_t>(((bits & 0xFFFF) * 100) >> 16);
+            bits >>= 16;
+        }
+    }
+
+    template<typename It>
+    void shuffle(It begin, It end) {
+        std::shuffle(begin, end, engine);
+    }
+
+    // Fixed sequence for reproducible runs (host/ tools)
+    void seed(uint32_t value) {
+        engine.seed(value);
+    }
+
+    uint32_t randomU32() {
+        return static_cast<uint32_t>(engine());
+    }
+
 private:
     std::mt19937 engine;
 };
\ No newline at end of file
@@ -0,0 +1,91 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#include "PatternTables.hpp"
+
+// Compile-time pitch quantizer table for the mod outputs. For every scale and pitch class above
+// the root it holds the semitone offset to the nearest scale note, so quantizing is a round and a load.
+
+namespace ScaleTables {
+
+constexpr const int kSemitones = 12;
+constexpr const int kScaleCount = 12;
+
+// Bit i = semitone i above the root is in the scale
+constexpr const uint16_t kScaleMasks[kScaleCount] = {
+    0xFFF, // chromatic
+    0xAB5, // major
+    0x5AD, // natural minor
+    0x6AD, // dorian
+    0x5AB, // phrygian
+    0xAD5, // lydian
+    0x6B5, // mixolydian
+    0x9AD, // harmonic minor
+    0x295, // major pentatonic
+    0x4A9, // minor pentatonic
+    0x4E9, // blues
+    0x555, // whole tone
+};
+
+const std::array<const char*, kScaleCount> kScaleNames = {{
+    "Chromatic", "Major", "Minor", "Dorian", "Phrygian", "Lydian",
+    "Mixolydian", "Harmonic minor", "Major pentatonic", "Minor pentatonic", "Blues", "Whole tone",
+}};
+
+const std::array<const char*, kSemitones> kRootNames = {{
+    "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B",
+}};
+
+constexpr bool inScale(int scale, int rel)
+{
+    return (kScaleMasks[scale] >> ((rel + kSemitones) % kSemitones)) & 1;
+}
+
+// Search outwards from rel, the lower note wins a tie
+constexpr int nearestOffset(int scale, int rel, int dist)
+{
+    return dist > kSemitones / 2 ? 0
+        : inScale(scale, rel - dist) ? -dist
+        : inScale(scale, rel + dist) ? dist
+        : nearestOffset(scale, rel, dist + 1);
+}
+
+constexpr int8_t quantizeEntry(int idx)
+{
+    return static_cast<int8_t>(nearestOffset(idx / kSemitones, idx % kSemitones + kSemitones, 0));
+}
+
+typedef PatternTables::Lut<int8_t, quantizeEntry, PatternTables::MakeIndexList<kScaleCount * kSemitones>::type> QuantizeLut;
+
+// 1V/oct, 0V = C
+inline float quantize(float volts, int scale, int root)
+{
+    const int note = static_cast<int>(std::round(volts * kSemitones));
+    const int rel = ((note - root) % kSemitones + kSemitones) % kSemitones;
+
+    return static_cast<float>(note + QuantizeLut::table[scale * kSemitones + rel]) / kSemitones;
+}
+
+} // namespace ScaleTables
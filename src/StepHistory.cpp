@@ -0,0 +1,92 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#include "StepHistory.hpp"
+
+static const std::array<int, 21> kStepFields = {{
+    HardSeqs::PARAM_STEP_ENABLED,
+    HardSeqs::PARAM_STEP_EACH1,
+    HardSeqs::PARAM_STEP_EACH2,
+    HardSeqs::PARAM_STEP_EACH3,
+    HardSeqs::PARAM_STEP_EACH4,
+    HardSeqs::PARAM_STEP_EACH5,
+    HardSeqs::PARAM_STEP_PROB,
+    HardSeqs::PARAM_STEP_MOD1,
+    HardSeqs::PARAM_STEP_MOD2,
+    HardSeqs::PARAM_STEP_MOD3,
+    HardSeqs::PARAM_STEP_ACCENT,
+    HardSeqs::PARAM_STEP_LANE5,
+    HardSeqs::PARAM_STEP_LANE6,
+    HardSeqs::PARAM_STEP_LANE7,
+    HardSeqs::PARAM_STEP_LANE8,
+    HardSeqs::PARAM_STEP_ELEN,
+    HardSeqs::PARAM_STEP_GLIDE,
+    HardSeqs::PARAM_STEP_DURATION,
+    HardSeqs::PARAM_STEP_COND,
+    HardSeqs::PARAM_STEP_CYCLE_A,
+    HardSeqs::PARAM_STEP_CYCLE_B,
+}};
+
+static void applyDeltas(int64_t module_id, const std::vector<StepDelta> &deltas, bool is_undo)
+{
+    auto module = dynamic_cast<HardSeqs*>(APP->engine->getModule(module_id));
+    if (!module)
+        return;
+
+    for (const auto &it : deltas)
+        module->m_steps[it.step].setField(it.param_id, is_undo ? it.before : it.after);
+
+    module->setSelectedStep(module->m_selected_step);
+    module->publishLinkedSteps();
+}
+
+void StepEditAction::undo()
+{
+    applyDeltas(moduleId, deltas, true);
+}
+
+void StepEditAction::redo()
+{
+    applyDeltas(moduleId, deltas, false);
+}
+
+void pushStepEdit(HardSeqs *module, const HardSeqs::StepTable &before, const std::string &name)
+{
+    std::vector<StepDelta> deltas;
+
+    for (int i = 0; i < kLenSteps; ++i) {
+        for (const auto param_id : kStepFields) {
+            const float old_val = before[i].field(param_id);
+            const float new_val = module->m_steps[i].field(param_id);
+
+            if (old_val != new_val)
+                deltas.push_back({static_cast<uint8_t>(i), static_cast<uint8_t>(param_id), old_val, new_val});
+        }
+    }
+
+    if (deltas.empty())
+        return;
+
+    auto action = new StepEditAction;
+    action->name = name;
+    action->moduleId = module->id;
+    action->deltas = std::move(deltas);
+
+    APP->history->push(action);
+}
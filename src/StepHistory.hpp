@@ -0,0 +1,48 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "HardSeqs.hpp"
+
+// One changed step field, param_id is the PARAM_STEP_* id of the field
+struct StepDelta
+{
+    uint8_t step;
+    uint8_t param_id;
+    float before;
+    float after;
+};
+
+// Undo entry for step edits, stores only the fields that changed instead of the whole module state
+struct StepEditAction : history::ModuleAction
+{
+    std::vector<StepDelta> deltas;
+
+    void undo() override;
+    void redo() override;
+};
+
+// Pushes a StepEditAction with the differences between before and the module's current steps,
+// nothing is pushed when they are equal
+void pushStepEdit(HardSeqs *module, const HardSeqs::StepTable &before, const std::string &name);
@@ -0,0 +1,59 @@
+/*
+ * This file is part of HardSeqs.
+ *
+ * HardSeqs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HardSeqs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HardSeqs. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2025 regular-dev team
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+// Hands the latest value of T from one writer thread to one reader thread without locks or
+// waiting. The writer fills back() completely and publishes it, the reader calls update() and
+// reads front(), which stays untouched until its next update(). Values in between may be skipped.
+template <typename T>
+class TripleBuffer
+{
+public:
+    T& back() { return m_slots[m_back]; }
+
+    void publish()
+    {
+        m_back = m_shared.exchange(m_back | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    // Returns true if front() now holds a newer value
+    bool update()
+    {
+        if ((m_shared.load(std::memory_order_relaxed) & kFresh) == 0)
+            return false;
+
+        m_front = m_shared.exchange(m_front, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+
+    const T& front() const { return m_slots[m_front]; }
+
+private:
+    static constexpr int kIndexMask = 3;
+    static constexpr int kFresh = 4;
+
+    std::array<T, 3> m_slots;
+    int m_back = 0;
+    std::atomic<int> m_shared {1};
+    int m_front = 2;
+};
@@ -100,7 +100,9 @@ struct CustomLightKnob : LightKnobSnap
 {
     protected:
         using Callback = std::function<void(int param_id)>;
+        using DragCallback = std::function<void(int param_id, bool is_start)>;
         Callback m_callback;
+        DragCallback m_drag_callback;
 
     public:
         CustomLightKnob() : LightKnobSnap() { }
@@ -110,6 +112,33 @@ struct CustomLightKnob : LightKnobSnap
             m_callback = f;
         }
 
+        // Drags reported here are recorded by the owner, Knob's own param history entry is skipped
+        void setDragCallback(DragCallback f)
+        {
+            m_drag_callback = f;
+        }
+
+        void onDragStart(const DragStartEvent &e) override
+        {
+            RoundKnob::onDragStart(e);
+
+            if (m_drag_callback && e.button == GLFW_MOUSE_BUTTON_LEFT)
+                m_drag_callback(paramId, true);
+        }
+
+        void onDragEnd(const DragEndEvent &e) override
+        {
+            if (!m_drag_callback || e.button != GLFW_MOUSE_BUTTON_LEFT) {
+                RoundKnob::onDragEnd(e);
+                return;
+            }
+
+            APP->window->cursorUnlock();
+            ParamWidget::onDragEnd(e);
+
+            m_drag_callback(paramId, false);
+        }
+
         void onChange(const ChangeEvent &e) override
         {
             RoundKnob::onChange(e);